@@ -0,0 +1,289 @@
+// bin/aot turns a chip8 rom into a C file that runs it without going through the interpreter
+//
+//   aot <rom file> <name>         writes the C for one rom to stdout, it defines struct aot_rom aot_rom_<name>
+//   aot --table <name> <name> ... writes the aot_roms[] list for the roms that get compiled into the build
+//
+// the rom is walked from 0x200 following every jump, call and skip, each instruction that can be reached becomes
+// a label with the C for it, and jumps turn into gotos. anything that can't be found this way (Bnnn targets, code
+// outside the rom) and any rom whose code has been written over at run time goes through step_single() instead, until
+// it is written back
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define PROGRAM_START 0x200
+
+static unsigned char memory[4096];
+static bool reachable[4096];
+static int rom_end;
+
+static unsigned short opcode_at(int address){
+    return memory[address] << 8 | memory[address + 1];
+}
+
+static bool in_rom(int address){
+    return address >= PROGRAM_START && address + 1 < rom_end;
+}
+
+// recursive descent over the rom, marks every address that can be reached without knowing register values
+static void find_code(void){
+    static unsigned short worklist[4096];
+    int count = 0;
+    worklist[count++] = PROGRAM_START;
+    while(count > 0){
+        int address = worklist[--count];
+        if(!in_rom(address) || reachable[address]){
+            continue;
+        }
+        reachable[address] = true;
+        unsigned short opcode = opcode_at(address);
+        int next[2];
+        int next_count = 0;
+        switch(opcode & 0xf000){
+            case 0x0000:
+                // 00EE goes back to after the 2nnn that called it, which is already on the list
+                if(opcode != 0x00EE){
+                    next[next_count++] = address + 2;
+                }
+            break;
+            case 0x1000:
+                next[next_count++] = opcode & 0x0fff;
+            break;
+            case 0x2000:
+                next[next_count++] = opcode & 0x0fff;
+                next[next_count++] = address + 2;
+            break;
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x9000:
+            case 0xE000:
+                next[next_count++] = address + 2;
+                next[next_count++] = address + 4;
+            break;
+            // Bnnn depends on V0, it is left to the interpreter
+            case 0xB000:
+            break;
+            default:
+                next[next_count++] = address + 2;
+        }
+        for(int i = 0; i < next_count; i++){
+            if(in_rom(next[i]) && !reachable[next[i]]){
+                worklist[count++] = next[i];
+            }
+        }
+    }
+}
+
+// jumps into compiled code go straight to its label, anything else goes to the dispatcher
+static void emit_goto(FILE* out, int target){
+    if(target >= 4096 || !reachable[target]){
+        fprintf(out, "    PC = 0x%03X; goto dispatch;\n", target);
+        return;
+    }
+    fprintf(out, "    goto L_%03X;\n", target);
+}
+
+static void emit_skip(FILE* out, const char* condition, int address){
+    fprintf(out, "    if(%s){\n    ", condition);
+    emit_goto(out, address + 4);
+    fprintf(out, "    }\n");
+    emit_goto(out, address + 2);
+}
+
+// the C for one instruction, the simple ones are written out here and the rest go through exec()
+// so they stay exactly the same as the interpreter
+static void emit_instruction(FILE* out, int address, int next_emitted){
+    unsigned short opcode = opcode_at(address);
+    int nnn = opcode & 0x0fff;
+    int x = (opcode >> 8) & 0x000f;
+    int y = (opcode >> 4) & 0x000f;
+    int kk = opcode & 0x00ff;
+    char condition[64];
+    bool falls_through = true;
+
+    // every instruction checks the budget, so a call stops on exactly count the same as the other cores and the
+    // program counter is only written out when it does
+    fprintf(out, "L_%03X: // %04X\n", address, opcode);
+    fprintf(out, "    if(done >= count){ PC = 0x%03X; return done; }\n", address);
+    fprintf(out, "    done += 1;\n");
+    switch(opcode & 0xf000){
+        case 0x1000:
+            emit_goto(out, nnn);
+            falls_through = false;
+        break;
+        case 0x2000:
+            fprintf(out, "    push(chip8, 0x%03X);\n", address + 2);
+            emit_goto(out, nnn);
+            falls_through = false;
+        break;
+        case 0x3000:
+            snprintf(condition, sizeof(condition), "V[%d] == 0x%02X", x, kk);
+            emit_skip(out, condition, address);
+            falls_through = false;
+        break;
+        case 0x4000:
+            snprintf(condition, sizeof(condition), "V[%d] != 0x%02X", x, kk);
+            emit_skip(out, condition, address);
+            falls_through = false;
+        break;
+        case 0x5000:
+            snprintf(condition, sizeof(condition), "V[%d] == V[%d]", x, y);
+            emit_skip(out, condition, address);
+            falls_through = false;
+        break;
+        case 0x9000:
+            snprintf(condition, sizeof(condition), "V[%d] != V[%d]", x, y);
+            emit_skip(out, condition, address);
+            falls_through = false;
+        break;
+        case 0x6000:
+            fprintf(out, "    V[%d] = 0x%02X;\n", x, kk);
+        break;
+        case 0x7000:
+            fprintf(out, "    V[%d] += 0x%02X;\n", x, kk);
+        break;
+        case 0xA000:
+            fprintf(out, "    I = 0x%03X;\n", nnn);
+        break;
+        case 0xB000:
+            fprintf(out, "    PC = 0x%03X + V[0];\n    goto dispatch;\n", nnn);
+            falls_through = false;
+        break;
+        default:
+            if(opcode == 0x00EE){
+                fprintf(out, "    PC = pop(chip8);\n    goto dispatch;\n");
+                falls_through = false;
+                break;
+            }
+            if((opcode & 0xf000) == 0x8000 && (opcode & 0x000f) <= 3){
+                static const char* operators[] = {"=", "|=", "&=", "^="};
+                fprintf(out, "    V[%d] %s V[%d];\n", x, operators[opcode & 0x000f], y);
+                break;
+            }
+            // the handler gets the program counter it would see in the interpreter, and if it moved it
+            // (an instruction that has to be run again) the dispatcher takes over from there
+            fprintf(out, "    PC = 0x%03X;\n    exec(chip8, 0x%04X);\n", address + 2, opcode);
+            fprintf(out, "    if(PC != 0x%03X) goto dispatch;\n", address + 2);
+            if((opcode & 0xf0ff) == 0xF033 || (opcode & 0xf0ff) == 0xF055){
+                int size = (opcode & 0x00ff) == 0x33 ? 3 : x + 1;
+                fprintf(out, "    if(code_changed(chip8, I, I + %d)){ stale = true; goto dispatch; }\n", size);
+            }
+    }
+    if(falls_through && next_emitted != address + 2){
+        emit_goto(out, address + 2);
+    }
+}
+
+static int compile(const char* path, const char* name){
+    FILE* f = fopen(path, "rb");
+    if(!f){
+        fprintf(stderr, "failed to open %s\n", path);
+        return -1;
+    }
+    size_t size = fread(&memory[PROGRAM_START], 1, sizeof(memory) - PROGRAM_START, f);
+    fclose(f);
+    rom_end = PROGRAM_START + size;
+    find_code();
+
+    FILE* out = stdout;
+    fprintf(out, "// generated by bin/aot from %s, do not edit\n", path);
+    fprintf(out, "#include \"chip8.h\"\n#include \"aot.h\"\n#include <string.h>\n\n");
+    fprintf(out, "#define V (chip8->reg.V)\n#define I (chip8->reg.I)\n#define PC (chip8->reg.program_counter)\n\n");
+
+    fprintf(out, "static const unsigned char image[%d] = {", (int)size);
+    for(size_t i = 0; i < size; i++){
+        fprintf(out, "%s0x%02X,", i % 16 ? " " : "\n    ", memory[PROGRAM_START + i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    // the bytes that were compiled, as [start, end) ranges, each reachable instruction covers 2 bytes
+    fprintf(out, "static const unsigned short code_ranges[][2] = {\n");
+    int ranges = 0;
+    int address = PROGRAM_START;
+    while(address < rom_end){
+        if(!reachable[address]){
+            address += 1;
+            continue;
+        }
+        int start = address;
+        while(address < rom_end && (reachable[address] || reachable[address - 1])){
+            address += 1;
+        }
+        fprintf(out, "    {0x%03X, 0x%03X},\n", start, address);
+        ranges += 1;
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "// true if any byte in [start, end) that was compiled no longer holds what the rom had there\n");
+    fprintf(out, "static bool code_changed(struct chip8* chip8, int start, int end){\n");
+    fprintf(out, "    for(int r = 0; r < %d; r++){\n", ranges);
+    fprintf(out, "        int low = start > code_ranges[r][0] ? start : code_ranges[r][0];\n");
+    fprintf(out, "        int high = end < code_ranges[r][1] ? end : code_ranges[r][1];\n");
+    fprintf(out, "        if(low < high && memcmp(&chip8->mem.memory_array[low], &image[low - 0x%03X], high - low) != 0){\n", PROGRAM_START);
+    fprintf(out, "            return true;\n        }\n    }\n    return false;\n}\n\n");
+
+    fprintf(out, "static long run(struct chip8* chip8, long count){\n");
+    fprintf(out, "    long done = 0;\n");
+    fprintf(out, "    bool stale = code_changed(chip8, 0, 4096);\n");
+    fprintf(out, "dispatch:\n");
+    fprintf(out, "    if(done >= count || keyboard_waiting(&chip8->keyboard)){\n        return done;\n    }\n");
+    fprintf(out, "    if(stale){\n        goto interpret;\n    }\n");
+    fprintf(out, "    switch(PC){\n");
+    for(int address = PROGRAM_START; address < rom_end; address++){
+        if(reachable[address]){
+            fprintf(out, "        case 0x%03X: goto L_%03X;\n", address, address);
+        }
+    }
+    fprintf(out, "        default:\n            goto interpret;\n    }\n");
+    // code outside what was compiled, and all of it while the program has some of the compiled code written over.
+    // step_single() so a fused sequence can't go past count. Fx33 and Fx55 are what write to memory, after one of
+    // them the compiled code can have been written over or back to what the rom had
+    fprintf(out, "interpret:\n    {\n");
+    fprintf(out, "        unsigned short opcode = chip8->mem.memory_array[PC & 0x0fff] << 8 | chip8->mem.memory_array[(PC + 1) & 0x0fff];\n");
+    fprintf(out, "        step_single(chip8);\n        done += 1;\n");
+    fprintf(out, "        if((opcode & 0xf0ff) == 0xF033 || (opcode & 0xf0ff) == 0xF055){\n");
+    fprintf(out, "            stale = code_changed(chip8, 0, 4096);\n        }\n");
+    fprintf(out, "        goto dispatch;\n    }\n");
+    int previous = -1;
+    for(int address = PROGRAM_START; address < rom_end; address++){
+        if(!reachable[address]){
+            continue;
+        }
+        if(previous >= 0){
+            emit_instruction(out, previous, address);
+        }
+        previous = address;
+    }
+    if(previous >= 0){
+        emit_instruction(out, previous, -1);
+    }
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "const struct aot_rom aot_rom_%s = {\"%s\", image, %d, run};\n", name, name, (int)size);
+    return 0;
+}
+
+static void table(int count, char** names){
+    printf("// generated by bin/aot --table, do not edit\n#include \"aot.h\"\n\n");
+    for(int i = 0; i < count; i++){
+        printf("extern const struct aot_rom aot_rom_%s;\n", names[i]);
+    }
+    printf("\nconst struct aot_rom* const aot_roms[] = {\n");
+    for(int i = 0; i < count; i++){
+        printf("    &aot_rom_%s,\n", names[i]);
+    }
+    printf("    0\n};\n");
+}
+
+int main(int argc, char** argv){
+    if(argc >= 2 && strcmp(argv[1], "--table") == 0){
+        table(argc - 2, argv + 2);
+        return 0;
+    }
+    if(argc != 3){
+        printf("usage: aot <rom file> <name>\n       aot --table <name>...\n");
+        return -1;
+    }
+    return compile(argv[1], argv[2]);
+}
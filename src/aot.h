@@ -0,0 +1,29 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct chip8;
+
+// a rom that was turned into C ahead of time by bin/aot, see src/aot.c
+struct aot_rom{
+    const char* name;
+    // the rom the code was built from, a program only runs on the compiled code if it is the same
+    const unsigned char* image;
+    unsigned short size;
+    // runs count instructions starting at the program counter, returns how many were run, fewer when the program starts
+    // waiting for a key. code that could not be found ahead of time or that the program wrote over goes through the
+    // interpreter
+    long (*run)(struct chip8* chip8, long count);
+};
+
+// the roms compiled into this build, the list is written out by bin/aot --table
+extern const struct aot_rom* const aot_roms[];
+
+// true if buffer holds the rom that was compiled
+bool aot_matches(const struct aot_rom* rom, const char* buffer, size_t size);
+// finds the compiled version of a rom, 0 if there is none
+const struct aot_rom* aot_find(const char* buffer, size_t size);
+
+#endif
@@ -0,0 +1,15 @@
+#include "aot.h"
+#include <string.h>
+
+bool aot_matches(const struct aot_rom* rom, const char* buffer, size_t size){
+    return rom->size == size && memcmp(rom->image, buffer, size) == 0;
+}
+
+const struct aot_rom* aot_find(const char* buffer, size_t size){
+    for(int i = 0; aot_roms[i]; i++){
+        if(aot_matches(aot_roms[i], buffer, size)){
+            return aot_roms[i];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "audio.h"
+#include <math.h>
+#include <string.h>
+
+static bool audio_push(struct audio* audio, struct audio_event event){
+    int tail = SDL_AtomicGet(&audio->tail);
+    if(tail - SDL_AtomicGet(&audio->head) == AUDIO_QUEUE_SIZE){
+        return false;
+    }
+    audio->events[tail % AUDIO_QUEUE_SIZE] = event;
+    // the event has to be in place before the callback can see the new tail
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&audio->tail, tail + 1);
+    return true;
+}
+
+// the next event without taking it out, false if there is none
+static bool audio_peek(struct audio* audio, struct audio_event* event){
+    int head = SDL_AtomicGet(&audio->head);
+    if(head == SDL_AtomicGet(&audio->tail)){
+        return false;
+    }
+    SDL_MemoryBarrierAcquire();
+    *event = audio->events[head % AUDIO_QUEUE_SIZE];
+    return true;
+}
+
+static void audio_drop(struct audio* audio){
+    // done reading the slot before the producer is allowed to write over it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&audio->head, SDL_AtomicGet(&audio->head) + 1);
+}
+
+// the sample an event plays at
+static int64_t event_sample(struct audio* audio, const struct audio_event* event){
+    int64_t sample = (int64_t)(event->time * audio->sample_rate / audio->rate);
+    int64_t target = sample + audio->offset;
+    // too late to play where it belongs or too far ahead to be right, the emulation skipped time or this is the
+    // first event. it plays after the latency from now and the ones after it keep their distance from it
+    if(!audio->synced || target < audio->position - audio->latency || target > audio->position + 4 * audio->latency){
+        audio->offset = audio->position + audio->latency - sample;
+        audio->synced = true;
+        target = audio->position + audio->latency;
+    }
+    return target;
+}
+
+static void apply(struct audio* audio, const struct audio_event* event){
+    switch(event->kind){
+        case AUDIO_GATE:
+            audio->gate = event->value;
+        break;
+        case AUDIO_PATTERN:
+            memcpy(audio->pattern, event->pattern, sizeof(audio->pattern));
+            audio->has_pattern = true;
+        break;
+        case AUDIO_PITCH:
+            audio->pitch = event->value;
+        break;
+    }
+}
+
+static void fill(void* data, Uint8* stream, int length){
+    struct audio* audio = data;
+    int16_t* samples = (int16_t*)stream;
+    int count = length / sizeof(int16_t);
+    for(int i = 0; i < count; i++){
+        struct audio_event event;
+        while(audio_peek(audio, &event) && event_sample(audio, &event) <= audio->position){
+            apply(audio, &event);
+            audio_drop(audio);
+        }
+        if(audio->gate && audio->has_pattern){
+            // nearest sample of the pattern, the bits go from the top of the first byte
+            int bit = audio->pattern_phase >> 25;
+            samples[i] = audio->pattern[bit >> 3] >> (7 - (bit & 7)) & 1 ? AUDIO_VOLUME : -AUDIO_VOLUME;
+            audio->pattern_phase += audio->pitch_steps[audio->pitch];
+        }
+        else if(audio->gate){
+            samples[i] = audio->phase >> 31 ? AUDIO_VOLUME : -AUDIO_VOLUME;
+            audio->phase += audio->step;
+        }
+        else{
+            samples[i] = 0;
+        }
+        audio->position += 1;
+    }
+}
+
+bool audio_open(struct audio* audio, long rate){
+    memset(audio, 0, sizeof(struct audio));
+    audio->rate = rate;
+    SDL_AudioSpec wanted, got;
+    SDL_zero(wanted);
+    wanted.freq = 48000;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples = 512;
+    wanted.callback = fill;
+    wanted.userdata = audio;
+    audio->device = SDL_OpenAudioDevice(NULL, 0, &wanted, &got, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if(!audio->device){
+        return false;
+    }
+    audio->sample_rate = got.freq;
+    audio->latency = got.freq / 60 + got.samples;
+    audio->step = (uint32_t)(((uint64_t)AUDIO_TONE << 32) / got.freq);
+    // 128 pattern samples make up the whole 32 bits of pattern_phase
+    for(int pitch = 0; pitch < 256; pitch++){
+        double pattern_rate = 4000 * pow(2, (pitch - 64) / 48.0);
+        audio->pitch_steps[pitch] = (uint32_t)(pattern_rate * (1 << 25) / got.freq);
+    }
+    audio->pitch = 64;
+    SDL_PauseAudioDevice(audio->device, 0);
+    return true;
+}
+
+void audio_close(struct audio* audio){
+    if(audio->device){
+        SDL_CloseAudioDevice(audio->device);
+    }
+}
+
+bool audio_gate(struct audio* audio, uint64_t time, bool on){
+    if(!audio->device){
+        return true;
+    }
+    struct audio_event event = {time, AUDIO_GATE, on};
+    return audio_push(audio, event);
+}
+
+bool audio_pattern(struct audio* audio, uint64_t time, const unsigned char pattern[16]){
+    if(!audio->device){
+        return true;
+    }
+    struct audio_event event = {time, AUDIO_PATTERN, 0};
+    memcpy(event.pattern, pattern, sizeof(event.pattern));
+    return audio_push(audio, event);
+}
+
+bool audio_pitch(struct audio* audio, uint64_t time, int pitch){
+    if(!audio->device){
+        return true;
+    }
+    struct audio_event event = {time, AUDIO_PITCH, pitch};
+    return audio_push(audio, event);
+}
@@ -0,0 +1,78 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "SDL2/SDL.h"
+
+#define AUDIO_QUEUE_SIZE 256
+// the square wave the sound timer plays until a program loads an XO-CHIP pattern, what Beep() used to play
+#define AUDIO_TONE 1500
+#define AUDIO_VOLUME 3000
+
+enum audio_event_kind{
+    // value is 1 when the sound timer started running and 0 when it ran out
+    AUDIO_GATE,
+    // F002 loaded pattern
+    AUDIO_PATTERN,
+    // Fx3A set the pitch to value
+    AUDIO_PITCH
+};
+
+struct audio_event{
+    // emulated time the change happened at, in instructions (see struct scheduler)
+    uint64_t time;
+    enum audio_event_kind kind;
+    int value;
+    unsigned char pattern[16];
+};
+
+// plays the sound timer through an SDL audio device. the emulation thread only puts timestamped changes into a
+// single producer single consumer ring, the callback on SDL's audio thread takes them out and makes the samples,
+// so sound costs the emulation next to nothing and never blocks it. emulated time is turned into sample positions
+// a little behind where the device is playing, so changes land at the right distance from each other even though
+// the emulation runs a tick's worth of instructions at once
+struct audio{
+    SDL_AudioDeviceID device;
+    // samples a second the device ended up with
+    int sample_rate;
+    // instructions a second of emulated time
+    long rate;
+    struct audio_event events[AUDIO_QUEUE_SIZE];
+    // both only ever go up, an event is at index % AUDIO_QUEUE_SIZE
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+
+    // everything below is only touched by the callback
+    // samples played so far
+    int64_t position;
+    // what gets added to an event's time in samples to get the sample it plays at, set from the first event and
+    // again whenever events stop lining up (the emulation fell behind and skipped ahead)
+    int64_t offset;
+    bool synced;
+    // how far behind the device events are played, enough to cover a tick and a buffer
+    int64_t latency;
+    bool gate;
+    uint32_t phase;
+    uint32_t step;
+    // the XO-CHIP pattern, played instead of the tone once one came in. the top 7 bits of pattern_phase are the
+    // sample it is on, pitch_steps[pitch] is how far it moves on for every sample of the device. the chip8 pitches
+    // are worked out for the device's rate once when it opens, so the callback only ever adds
+    bool has_pattern;
+    unsigned char pattern[16];
+    int pitch;
+    uint32_t pattern_phase;
+    uint32_t pitch_steps[256];
+};
+
+// false if there is no audio device, the emulator runs without sound then and audio_gate() does nothing
+bool audio_open(struct audio* audio, long rate);
+void audio_close(struct audio* audio);
+// emulation thread, the sound timer started or stopped at emulated time. false if the ring is full and the
+// change has to be sent again later
+bool audio_gate(struct audio* audio, uint64_t time, bool on);
+// emulation thread, F002 and Fx3A, false if the ring is full the same as audio_gate()
+bool audio_pattern(struct audio* audio, uint64_t time, const unsigned char pattern[16]);
+bool audio_pitch(struct audio* audio, uint64_t time, int pitch);
+
+#endif
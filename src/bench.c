@@ -0,0 +1,114 @@
+// bin/bench runs roms headless on each of the cores and prints how many million instructions per second they get
+//   bench [--ips n] <instructions> <rom file>...
+// --ips is the rate the scheduler runs the roms at, BENCH_DEFAULT_RATE if it is not given. every call into a core runs
+// at most a tick's worth of instructions, so at the 600 of the frontends (--ips 600) a call is about 10 instructions and
+// what gets measured is mostly the cost of going in and out of the core. the default is high enough that it is the
+// instructions themselves
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chip8.h"
+#include "cores.h"
+#include "scheduler.h"
+
+// 100000 instructions a tick
+#define BENCH_DEFAULT_RATE 6000000
+
+// there is nobody at the keyboard, this only keeps key_map() happy. a rom that waits for a key gets 0 pressed for it
+static const char keys[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+static void start_rom(const struct core* core, struct chip8* chip8, const char* buffer, size_t size){
+    init(chip8);
+    load(chip8, buffer, size);
+    keyboard_set_map(&chip8->keyboard, keys);
+    core_start(core, chip8);
+}
+
+// the last rom that was run, kept around so its counters can be printed
+static struct chip8 chip8;
+static struct scheduler scheduler;
+
+// runs the rom a tick at a time the same as headless, so the timers go down at the pace the program expects whatever
+// the core
+static double run_rom(const struct core* core, const char* buffer, size_t size, long instructions, long rate){
+    start_rom(core, &chip8, buffer, size);
+    scheduler_init(&scheduler, rate);
+    long done = 0;
+    clock_t start = clock();
+    while(done < instructions){
+        while(scheduler_due(&scheduler) > 0){
+            // some roms call deeper every time 0 is pressed (INVADERS). once the stack is full the next call is past
+            // the end of it and push() asserts, so the rom starts over then
+            if(chip8.reg.stack_pointer == 16){
+                start_rom(core, &chip8, buffer, size);
+            }
+            // the cores hand back as soon as a program starts waiting for a key
+            if(keyboard_waiting(&chip8.keyboard)){
+                key_down(&chip8.keyboard, 0);
+                key_up(&chip8.keyboard, 0);
+            }
+            long ran = core->run(&chip8, scheduler_due(&scheduler));
+            scheduler_advance(&scheduler, ran);
+            done += ran;
+        }
+        scheduler_tick(&scheduler, &chip8);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return done / seconds / 1000000;
+}
+
+int main(int argc, char** argv){
+    long rate = BENCH_DEFAULT_RATE;
+    int first = 1;
+    if(argc > 2 && strcmp(argv[1], "--ips") == 0){
+        rate = atol(argv[2]);
+        first = 3;
+    }
+    if(argc < first + 2 || rate < 1){
+        printf("usage: bench [--ips n] <instructions> <rom file>...\n");
+        return -1;
+    }
+    long instructions = atol(argv[first]);
+    printf("%ld instructions a second, %ld a tick\n", rate, rate / SCHEDULER_TICKS_PER_SECOND);
+    struct fusion_stats fusion_stats[argc];
+    printf("%-16s", "rom");
+    for(int c = 0; c < core_count; c++){
+        printf("%12s", cores[c].name);
+    }
+    printf("\n");
+    for(int i = first + 1; i < argc; i++){
+        FILE* f = fopen(argv[i], "rb");
+        fusion_stats[i] = (struct fusion_stats){0};
+        if(!f){
+            printf("failed to open %s\n", argv[i]);
+            continue;
+        }
+        static char buffer[4096];
+        size_t size = fread(buffer, 1, sizeof(buffer) - 0x200, f);
+        fclose(f);
+        printf("%-16s", argv[i]);
+        for(int c = 0; c < core_count; c++){
+            printf("%12.1f", run_rom(&cores[c], buffer, size, instructions, rate));
+            // the table core goes through step() and so the fused instructions, see fusion.c
+            if(strcmp(cores[c].name, "table") == 0){
+                fusion_stats[i] = chip8.fusion;
+            }
+        }
+        printf("\n");
+    }
+
+    printf("\nfused instructions run on the table core\n%-16s", "rom");
+    for(int f = 0; f < FUSION_COUNT; f++){
+        printf("%16s", fusion_name(f));
+    }
+    printf("\n");
+    for(int i = first + 1; i < argc; i++){
+        printf("%-16s", argv[i]);
+        for(int f = 0; f < FUSION_COUNT; f++){
+            printf("%16lu", fusion_stats[i].fired[f]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
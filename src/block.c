@@ -0,0 +1,98 @@
+#include "block.h"
+#include "chip8.h"
+#include "dispatch.h"
+
+bool ends_block(unsigned short opcode){
+    switch(opcode & 0xf000){
+        case 0x0000:
+            // 00EE - RET
+            return opcode == 0x00EE;
+        // jumps, calls and every kind of skip change the program counter
+        case 0x1000:
+        case 0x2000:
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xB000:
+        case 0xE000:
+            return true;
+        case 0xF000:
+            // Fx33 and Fx55 write to memory and might write over the rest of the block, Fx0A waits for a key
+            return (opcode & 0x00ff) == 0x0033 || (opcode & 0x00ff) == 0x0055 || (opcode & 0x00ff) == 0x000A;
+    }
+    return false;
+}
+
+static inline bool block_is_current(struct memory* mem, struct block* block, unsigned short start){
+    return block->valid && block->start == start
+        && block->version[0] == mem->page_version[block->page]
+        && block->version[1] == mem->page_version[block->page + 1];
+}
+
+// reads instructions from start until one that ends the block
+// this goes to memory and not the decoded cache, the cache may hold fused instructions (see fusion.c) that would run more than one
+static void build_block(struct memory* mem, struct block* block, unsigned short start){
+    int length = 0;
+    int address = start;
+    while(length < BLOCK_MAX_LENGTH && address + 1 < 4096){
+        unsigned short opcode = memory_get_short(mem, address);
+        length += 1;
+        address += 2;
+        if(ends_block(opcode)){
+            break;
+        }
+    }
+    block->valid = true;
+    block->start = start;
+    block->length = length;
+    block->page = start / MEMORY_PAGE_SIZE;
+    block->version[0] = mem->page_version[block->page];
+    block->version[1] = mem->page_version[block->page + 1];
+}
+
+// runs the block at the program counter, or only its first limit instructions when it is longer than that so a caller
+// with a budget stops exactly on it
+static inline int run_block(struct chip8* chip8, long limit){
+    unsigned short start = chip8->reg.program_counter;
+    // an instruction at 0xFFF has no room for a block, it is left to step() the same as in jit_run(). step() also
+    // asserts on a program counter past the end of memory
+    if(start + 1 >= 4096){
+        step(chip8);
+        return 1;
+    }
+    struct block* block = &chip8->blocks.blocks[(start >> 1) % BLOCK_CACHE_SIZE];
+    if(!block_is_current(&chip8->mem, block, start)){
+        build_block(&chip8->mem, block, start);
+    }
+    const unsigned char* op = &chip8->mem.memory_array[start];
+    if(block->length > limit){
+        // the last instruction is not one of these, so none of them move the program counter or write to memory
+        const unsigned char* end = op + 2 * limit;
+        for(; op != end; op += 2){
+            run_instruction(chip8, decode(op[0] << 8 | op[1]));
+        }
+        chip8->reg.program_counter = start + 2 * limit;
+        return limit;
+    }
+    const unsigned char* last = op + 2 * (block->length - 1);
+    // nothing before the last instruction reads or changes the program counter, so it is only moved once
+    for(; op != last; op += 2){
+        run_instruction(chip8, decode(op[0] << 8 | op[1]));
+    }
+    chip8->reg.program_counter = start + 2 * block->length;
+    run_instruction(chip8, decode(last[0] << 8 | last[1]));
+    return block->length;
+}
+
+int exec_block(struct chip8* chip8){
+    return run_block(chip8, BLOCK_MAX_LENGTH);
+}
+
+long exec_blocks(struct chip8* chip8, long count){
+    long done = 0;
+    while(done < count && !keyboard_waiting(&chip8->keyboard)){
+        done += run_block(chip8, count - done);
+    }
+    return done;
+}
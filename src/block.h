@@ -0,0 +1,36 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdbool.h>
+
+// longest run of instructions in one block, 32 instructions = 64 bytes so a block touches at most 2 memory pages
+#define BLOCK_MAX_LENGTH 32
+// number of blocks kept per chip8, the slot is picked from the start address
+#define BLOCK_CACHE_SIZE 256
+
+struct chip8;
+
+// a straight line run of instructions, only the last one can change the program counter or write to memory
+// the opcodes are read from memory when it runs, the versions say they are still the ones it was built from
+struct block{
+    bool valid;
+    unsigned short start;
+    unsigned short length;
+    // memory page of the first instruction, and the versions of it and the page after it when the block was built
+    unsigned short page;
+    unsigned int version[2];
+};
+
+struct block_cache{
+    struct block blocks[BLOCK_CACHE_SIZE];
+};
+
+// true for the opcodes that have to be the last instruction of a block
+bool ends_block(unsigned short opcode);
+// runs the block starting at the program counter, building it first if needed, returns the number of instructions run
+int exec_block(struct chip8* chip8);
+// keeps running blocks back to back until count instructions have been run, the last block stops partway through if it
+// has to. returns how many were run, less than count when the program starts waiting for a key
+long exec_blocks(struct chip8* chip8, long count);
+
+#endif
@@ -0,0 +1,279 @@
+// bin/capconv turns a capture (see capture.h) into a video
+//   capconv <capture file> <output file> [scale]
+//
+// the output is Y4M when the name ends in .y4m and GIF when it ends in .gif. every frame is drawn on the 128x64
+// hi-res grid, a lo-res pixel being 2x2, and that is made scale times bigger, 1 if it is not given.
+// Y4M is 60 frames a second, a frame that stayed on the screen longer is repeated. GIF gives each frame its own delay
+// in hundredths of a second, so frames that were shown for less than that are left out
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "capture.h"
+
+enum format{
+    FORMAT_Y4M,
+    FORMAT_GIF
+};
+
+static enum format format;
+static int scale;
+static int width;
+static int height;
+// one byte per output pixel, 1 for on
+static unsigned char* image;
+
+// draws the frame into image at the output size
+static void draw_image(const struct screen* screen){
+    int pixel_size = (screen->hires ? 1 : 2) * scale;
+    for(int y = 0; y < height; y++){
+        int row = y / pixel_size;
+        for(int x = 0; x < width; x++){
+            int column = x / pixel_size;
+            uint64_t word = screen->rows[row * screen_row_words(screen) + column / 64];
+            image[y * width + x] = word >> (63 - column % 64) & 1;
+        }
+    }
+}
+
+// Y4M frames are numbered at 60 a second, rounded to the nearest one
+static long y4m_frame(uint32_t time){
+    return ((long)time * 60 + 500) / 1000;
+}
+
+static void write_y4m_header(FILE* out){
+    fprintf(out, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n", width, height);
+}
+
+static void write_y4m(FILE* out, const struct screen* screen, uint32_t start, uint32_t end){
+    draw_image(screen);
+    long count = y4m_frame(end) - y4m_frame(start);
+    for(long i = 0; i < count; i++){
+        fprintf(out, "FRAME\n");
+        for(int p = 0; p < width * height; p++){
+            fputc(image[p] ? 235 : 16, out);
+        }
+        // no colour, both chroma planes at a quarter of the size stay in the middle
+        for(int p = 0; p < width * height / 2; p++){
+            fputc(128, out);
+        }
+    }
+}
+
+// GIF image data is LZW codes packed from the lowest bit up, in blocks of at most 255 bytes
+struct gif_writer{
+    FILE* out;
+    unsigned char block[255];
+    int block_size;
+    uint32_t bits;
+    int bit_count;
+};
+
+static void gif_flush_block(struct gif_writer* gif){
+    if(gif->block_size){
+        fputc(gif->block_size, gif->out);
+        fwrite(gif->block, 1, gif->block_size, gif->out);
+        gif->block_size = 0;
+    }
+}
+
+static void gif_code(struct gif_writer* gif, int code, int code_width){
+    gif->bits |= (uint32_t)code << gif->bit_count;
+    gif->bit_count += code_width;
+    while(gif->bit_count >= 8){
+        gif->block[gif->block_size++] = gif->bits & 0xff;
+        gif->bits >>= 8;
+        gif->bit_count -= 8;
+        if(gif->block_size == 255){
+            gif_flush_block(gif);
+        }
+    }
+}
+
+// 2 colours need the smallest code size GIF allows, 2 bits, so 4 is the clear code, 5 the end and 6 the first free one
+#define GIF_MIN_CODE_SIZE 2
+#define GIF_CLEAR 4
+#define GIF_END 5
+#define GIF_MAX_CODES 4096
+
+static void write_gif_image(FILE* out){
+    // the dictionary is a tree, the code for a string followed by a pixel is next[string][pixel], 0 when there is none
+    static unsigned short next[GIF_MAX_CODES][4];
+    struct gif_writer gif = {out};
+    fputc(GIF_MIN_CODE_SIZE, out);
+    memset(next, 0, sizeof(next));
+    int free_code = GIF_END + 1;
+    int code_width = GIF_MIN_CODE_SIZE + 1;
+    gif_code(&gif, GIF_CLEAR, code_width);
+    int string = image[0];
+    for(int p = 1; p < width * height; p++){
+        int pixel = image[p];
+        if(next[string][pixel]){
+            string = next[string][pixel];
+            continue;
+        }
+        gif_code(&gif, string, code_width);
+        if(free_code < GIF_MAX_CODES){
+            next[string][pixel] = free_code++;
+            // the reader adds each code one step behind, so it only needs the wider codes once it has gone past a power of 2
+            if(free_code > 1 << code_width && code_width < 12){
+                code_width += 1;
+            }
+        }
+        else{
+            // the table is full, start it over
+            gif_code(&gif, GIF_CLEAR, code_width);
+            memset(next, 0, sizeof(next));
+            free_code = GIF_END + 1;
+            code_width = GIF_MIN_CODE_SIZE + 1;
+        }
+        string = pixel;
+    }
+    gif_code(&gif, string, code_width);
+    gif_code(&gif, GIF_END, code_width);
+    if(gif.bit_count){
+        gif_code(&gif, 0, 8 - gif.bit_count);
+    }
+    gif_flush_block(&gif);
+    // the block terminator
+    fputc(0, out);
+}
+
+static void write_short(FILE* out, int value){
+    fputc(value & 0xff, out);
+    fputc(value >> 8 & 0xff, out);
+}
+
+static void write_gif_header(FILE* out){
+    fwrite("GIF89a", 1, 6, out);
+    write_short(out, width);
+    write_short(out, height);
+    // a global colour table of 2 entries, black and white
+    fputc(0x80, out);
+    fputc(0, out);
+    fputc(0, out);
+    fwrite("\x00\x00\x00\xff\xff\xff", 1, 6, out);
+    // the NETSCAPE2.0 extension, loop forever
+    fwrite("\x21\xff\x0bNETSCAPE2.0\x03\x01\x00\x00\x00", 1, 19, out);
+}
+
+static void write_gif(FILE* out, const struct screen* screen, uint32_t start, uint32_t end){
+    int delay = end / 10 - start / 10;
+    if(delay <= 0){
+        return;
+    }
+    draw_image(screen);
+    // graphic control extension with the delay, then the image covering the whole screen
+    fwrite("\x21\xf9\x04\x00", 1, 4, out);
+    write_short(out, delay);
+    fputc(0, out);
+    fputc(0, out);
+    fputc(0x2c, out);
+    write_short(out, 0);
+    write_short(out, 0);
+    write_short(out, width);
+    write_short(out, height);
+    fputc(0, out);
+    write_gif_image(out);
+}
+
+// a frame is written once the next one says how long it was on the screen
+static void write_frame(FILE* out, const struct screen* screen, uint32_t start, uint32_t end){
+    if(format == FORMAT_Y4M){
+        write_y4m(out, screen, start, end);
+    }
+    else{
+        write_gif(out, screen, start, end);
+    }
+}
+
+static bool ends_with(const char* name, const char* ending){
+    size_t length = strlen(name);
+    return length >= strlen(ending) && strcmp(name + length - strlen(ending), ending) == 0;
+}
+
+int main(int argc, char** argv){
+    if(argc != 3 && argc != 4){
+        printf("usage: capconv <capture file> <output .y4m or .gif> [scale]\n");
+        return -1;
+    }
+    if(ends_with(argv[2], ".y4m")){
+        format = FORMAT_Y4M;
+    }
+    else if(ends_with(argv[2], ".gif")){
+        format = FORMAT_GIF;
+    }
+    else{
+        fprintf(stderr, "%s is not a .y4m or .gif file\n", argv[2]);
+        return -1;
+    }
+    scale = argc == 4 ? atoi(argv[3]) : 1;
+    if(scale < 1 || scale > 16){
+        fprintf(stderr, "scale has to be 1 to 16\n");
+        return -1;
+    }
+    width = HIRES_WIDTH * scale;
+    height = HIRES_HEIGHT * scale;
+
+    FILE* f = fopen(argv[1], "rb");
+    if(!f){
+        fprintf(stderr, "failed to open %s\n", argv[1]);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* data = malloc(size);
+    if(!data || fread(data, 1, size, f) != (size_t)size){
+        fprintf(stderr, "failed to read %s\n", argv[1]);
+        return -1;
+    }
+    fclose(f);
+    if(!capture_check_magic(data, size)){
+        fprintf(stderr, "%s is not a capture\n", argv[1]);
+        return -1;
+    }
+
+    FILE* out = fopen(argv[2], "wb");
+    if(!out){
+        fprintf(stderr, "failed to open %s\n", argv[2]);
+        return -1;
+    }
+    image = malloc(width * height);
+    if(format == FORMAT_Y4M){
+        write_y4m_header(out);
+    }
+    else{
+        write_gif_header(out);
+    }
+
+    static struct capture_decoder decoder;
+    static struct screen shown;
+    capture_decoder_init(&decoder);
+    long used = CAPTURE_MAGIC_SIZE;
+    long frames = 0;
+    uint32_t shown_at = 0;
+    while(used < size){
+        int record = capture_decode(&decoder, &data[used], size - used);
+        if(record < 0){
+            fprintf(stderr, "%s is cut short or broken after %ld frames\n", argv[1], frames);
+            break;
+        }
+        used += record;
+        if(frames > 0){
+            write_frame(out, &shown, shown_at, decoder.time);
+        }
+        shown = decoder.screen;
+        shown_at = decoder.time;
+        frames += 1;
+    }
+    // the last frame stays up for one frame at 60 a second
+    if(frames > 0){
+        write_frame(out, &shown, shown_at, shown_at + 17);
+    }
+    if(format == FORMAT_GIF){
+        fputc(0x3b, out);
+    }
+    fclose(out);
+    printf("%ld frames, %.1f seconds\n", frames, decoder.time / 1000.0);
+    return 0;
+}
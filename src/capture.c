@@ -0,0 +1,156 @@
+#include "capture.h"
+#include <string.h>
+
+void capture_encoder_init(struct capture_encoder* encoder){
+    memset(encoder, 0, sizeof(struct capture_encoder));
+    encoder->key_next = true;
+}
+
+void capture_skip(struct capture_encoder* encoder){
+    encoder->key_next = true;
+}
+
+// the bytes of one word that changed, left to right, after a byte saying which ones they are
+static int encode_word(uint64_t change, unsigned char* out){
+    unsigned char mask = 0;
+    int size = 1;
+    for(int i = 0; i < 8; i++){
+        unsigned char byte = change >> (56 - 8 * i);
+        if(byte){
+            mask |= 1 << i;
+            out[size++] = byte;
+        }
+    }
+    out[0] = mask;
+    return size;
+}
+
+int capture_encode(struct capture_encoder* encoder, const struct screen* screen, uint32_t time, unsigned char* out){
+    const struct screen* previous = &encoder->previous;
+    // a frame in the other mode has different rows, there is nothing to XOR it against
+    bool key = encoder->key_next || encoder->frames_since_key >= CAPTURE_KEY_INTERVAL || screen->hires != previous->hires;
+    int height = screen_height(screen);
+    int size = 0;
+    out[size++] = (key ? CAPTURE_KEY : 0) | (screen->hires ? CAPTURE_HIRES : 0);
+
+    uint32_t delta = encoder->started ? time - encoder->previous_time : 0;
+    while(delta >= 0x80){
+        out[size++] = (delta & 0x7f) | 0x80;
+        delta >>= 7;
+    }
+    out[size++] = delta;
+
+    // the rows that changed, which for a key frame is every row with something on it
+    int words = screen_row_words(screen);
+    uint64_t rows = 0;
+    if(key){
+        for(int y = 0; y < height; y++){
+            if(screen->rows[y * words] | screen->rows[y * words + words - 1]){
+                rows |= (uint64_t)1 << y;
+            }
+        }
+    }
+    else{
+        rows = screen_diff(previous, screen);
+    }
+    for(int i = 0; i < height / 8; i++){
+        out[size++] = rows >> (8 * i);
+    }
+    for(int y = 0; y < height; y++){
+        if(!(rows & (uint64_t)1 << y)){
+            continue;
+        }
+        // the left word and then the right one in hi-res, the same order they are in the row
+        for(int i = y * words; i < (y + 1) * words; i++){
+            size += encode_word(key ? screen->rows[i] : screen->rows[i] ^ previous->rows[i], &out[size]);
+        }
+    }
+
+    encoder->previous = *screen;
+    encoder->previous_time = time;
+    encoder->started = true;
+    encoder->frames_since_key = key ? 0 : encoder->frames_since_key + 1;
+    encoder->key_next = false;
+    return size;
+}
+
+void capture_decoder_init(struct capture_decoder* decoder){
+    memset(decoder, 0, sizeof(struct capture_decoder));
+}
+
+bool capture_check_magic(const unsigned char* data, size_t size){
+    return size >= CAPTURE_MAGIC_SIZE && memcmp(data, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) == 0;
+}
+
+// the other side of encode_word(), returns how many bytes it took or -1 if data ran out
+static int decode_word(uint64_t* word, const unsigned char* data, size_t size){
+    if(size < 1){
+        return -1;
+    }
+    unsigned char mask = data[0];
+    size_t used = 1;
+    for(int i = 0; i < 8; i++){
+        if(!(mask & 1 << i)){
+            continue;
+        }
+        if(used >= size){
+            return -1;
+        }
+        *word ^= (uint64_t)data[used++] << (56 - 8 * i);
+    }
+    return used;
+}
+
+int capture_decode(struct capture_decoder* decoder, const unsigned char* data, size_t size){
+    struct screen* screen = &decoder->screen;
+    size_t used = 0;
+    if(size < 1){
+        return -1;
+    }
+    unsigned char flags = data[used++];
+    bool hires = (flags & CAPTURE_HIRES) != 0;
+
+    uint32_t delta = 0;
+    for(int shift = 0; ; shift += 7){
+        if(used >= size || shift > 28){
+            return -1;
+        }
+        delta |= (uint32_t)(data[used] & 0x7f) << shift;
+        if(!(data[used++] & 0x80)){
+            break;
+        }
+    }
+
+    if(flags & CAPTURE_KEY){
+        memset(screen, 0, sizeof(struct screen));
+        screen->hires = hires;
+    }
+    else if(screen->hires != hires){
+        // only a key frame can change the mode
+        return -1;
+    }
+    int height = screen_height(screen);
+    if(size - used < (size_t)height / 8){
+        return -1;
+    }
+    uint64_t rows = 0;
+    for(int i = 0; i < height / 8; i++){
+        rows |= (uint64_t)data[used++] << (8 * i);
+    }
+    for(int y = 0; y < height; y++){
+        if(!(rows & (uint64_t)1 << y)){
+            continue;
+        }
+        int words = screen_row_words(screen);
+        for(int i = y * words; i < (y + 1) * words; i++){
+            int word_size = decode_word(&screen->rows[i], &data[used], size - used);
+            if(word_size < 0){
+                return -1;
+            }
+            used += word_size;
+        }
+    }
+    screen->hash = screen_rehash(screen);
+    decoder->time += delta;
+    return used;
+}
@@ -0,0 +1,58 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "screen.h"
+
+// the capture format, for recording what was shown on the screen. bin/capconv turns a capture into Y4M or GIF
+//
+// a capture starts with the 7 bytes CAPTURE_MAGIC and then has one record per frame:
+//   1 byte        CAPTURE_KEY and CAPTURE_HIRES flags
+//   varint        milliseconds since the frame before, 7 bits at a time with the high bit set on all but the last byte
+//   4 or 8 bytes  bit y set for every row y that changed, little endian, 8 bytes in hi-res
+//   every changed row, one word in lo-res and two in hi-res: a byte with bit i set when byte i of the word (counting
+//   from the left) changed, followed by those bytes XORed with what was there in the frame before
+// a key frame is XORed against a blank screen instead, so decoding can start from it
+#define CAPTURE_MAGIC "CH8CAP\x01"
+#define CAPTURE_MAGIC_SIZE 7
+#define CAPTURE_KEY 0x01
+#define CAPTURE_HIRES 0x02
+// the most a single frame record can take up
+#define CAPTURE_FRAME_MAX (1 + 5 + 8 + HIRES_HEIGHT * 2 * 9)
+// a key frame goes out at least this often, about every 10 seconds at 60 frames a second
+#define CAPTURE_KEY_INTERVAL 600
+
+struct capture_encoder{
+    // the last frame that was encoded, what the next one is XORed against
+    struct screen previous;
+    uint32_t previous_time;
+    // false until the first frame, which is at time 0 in the capture
+    bool started;
+    unsigned frames_since_key;
+    // the next frame has to be a key frame, set at the start and when a frame had to be left out
+    bool key_next;
+};
+
+void capture_encoder_init(struct capture_encoder* encoder);
+// writes the record for screen into out, which needs room for CAPTURE_FRAME_MAX bytes, and returns how many bytes it took
+// time is in milliseconds from any starting point, it only has to go up
+int capture_encode(struct capture_encoder* encoder, const struct screen* screen, uint32_t time, unsigned char* out);
+// for a frame that was never written, the one after it is a key frame so the capture stays readable
+void capture_skip(struct capture_encoder* encoder);
+
+struct capture_decoder{
+    // the frame as of the last record read
+    struct screen screen;
+    // milliseconds since the first frame
+    uint32_t time;
+};
+
+void capture_decoder_init(struct capture_decoder* decoder);
+// true if data starts with CAPTURE_MAGIC
+bool capture_check_magic(const unsigned char* data, size_t size);
+// reads the record at the start of data into decoder->screen, returns how many bytes it took or -1 if it is cut short or broken
+int capture_decode(struct capture_decoder* decoder, const unsigned char* data, size_t size);
+
+#endif
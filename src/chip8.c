@@ -1,10 +1,8 @@
 #include "chip8.h"
+#include "dispatch.h"
 #include <string.h>
 #include <assert.h>
 #include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include "SDL2/SDL.h"
 
 // section 2.4 of the reference a binary representation can be found there as well
 // if a bit = 1, then pixel there is on, otherwise it's off
@@ -30,27 +28,39 @@ void init(struct chip8* chip8){
     // set everything to 0
     memset(chip8, 0, sizeof(struct chip8));
     memcpy(&chip8->mem.memory_array, default_character_set, sizeof(default_character_set));
+    // XO-CHIP starts out at 4000 samples a second
+    chip8->reg.pitch = 64;
+    chip8_seed(chip8, CHIP8_DEFAULT_SEED);
+    // the opcode table is shared by every chip8 instance, it is only filled the first time around
+    dispatch_init();
+}
+void chip8_seed(struct chip8* chip8, uint32_t seed){
+    chip8->random = seed ? seed : CHIP8_DEFAULT_SEED;
 }
 void load(struct chip8* chip8, const char* buffer, size_t size){
     // making sure we are not going out of bound -> program load area starts from 0x200
     assert(size + 0x200 < 4096);
     // loading the program into the memory, buffer is the source
     memcpy(&chip8->mem.memory_array[0x200], buffer, size);
+    // the copy does not go through memory_set(), so anything decoded from a previous program has to be thrown away here
+    memory_invalidate(&chip8->mem, 0x200, size);
     // have program counter point to the beginning of the intructions, which is 0x200
     chip8->reg.program_counter = 0x200;
 }
+// Fx0A puts the keyboard into its waiting state and moves the program counter back so it runs again. the run loops see
+// keyboard_waiting() and hand back without running anything until key_down() (or key_up() with wait_for_release)
+// ends the wait, then the Fx0A runs again and takes the key
 char wait_for_key_press(struct chip8* chip8){
-    SDL_Event event;
-    while(SDL_WaitEvent(&event)){
-        if(event.type != SDL_KEYDOWN){
-            continue;
-        }
-        char c = event.key.keysym.sym;
-        char key = key_map(&chip8->keyboard, c);
-        if(key != -1){
-            return key;
-        }
+    struct keyboard* board = &chip8->keyboard;
+    if(board->waiting && board->wait_key >= 0){
+        board->waiting = false;
+        return board->wait_key;
+    }
+    if(!board->waiting){
+        keyboard_start_wait(board);
     }
+    chip8->reg.program_counter -= 2;
+    return chip8->reg.V[(memory_get_short(&chip8->mem, chip8->reg.program_counter) >> 8) & 0x000f];
 }
 void exec_4(struct chip8* chip8, unsigned short opcode){
     unsigned short nnn = opcode & 0x0fff;
@@ -59,11 +69,22 @@ void exec_4(struct chip8* chip8, unsigned short opcode){
     unsigned char kk = opcode & 0x00ff;
     unsigned short n = opcode & 0x000f;
     switch(opcode & 0x00ff){
+        // F002 - AUDIO, XO-CHIP
+        // Load the 16 byte audio pattern from memory starting at location I.
+        // The sound timer plays its 128 bits as 1 bit samples instead of a plain tone once this has run.
+        case 0x0002:
+            if(x == 0){
+                for(int i = 0; i < 16; i++){
+                    chip8->reg.pattern[i] = memory_get(&chip8->mem, chip8->reg.I+i);
+                }
+                chip8->reg.pattern_version += 1;
+            }
+        break;
         // Fx07 - LD Vx, DT
         // Set Vx = delay timer value.
         // The value of DT is placed into Vx.
         case 0x0007:
-            chip8->reg.V[x] = chip8->reg.delay_timer;
+            chip8->reg.V[x] = delay_timer_get(&chip8->reg);
         break;
         // Fx0A - LD Vx, K
         // Wait for a key press, store the value of the key in Vx.
@@ -75,13 +96,13 @@ void exec_4(struct chip8* chip8, unsigned short opcode){
         // Set delay timer = Vx.
         // DT is set equal to the value of Vx.
         case 0x0015:
-            chip8->reg.delay_timer = chip8->reg.V[x];
+            delay_timer_set(&chip8->reg, chip8->reg.V[x]);
         break;
         // Fx18 - LD ST, Vx
         // Set sound timer = Vx.
         // ST is set equal to the value of Vx.
         case 0x0018:
-            chip8->reg.sound_timer = chip8->reg.V[x];
+            sound_timer_set(&chip8->reg, chip8->reg.V[x]);
         break;
         // Fx1E - ADD I, Vx
         // Set I = I + Vx.
@@ -124,6 +145,12 @@ void exec_4(struct chip8* chip8, unsigned short opcode){
                 chip8->reg.V[i] = memory_get(&chip8->mem, chip8->reg.I+i); 
             }
         break;
+        // Fx3A - PITCH Vx, XO-CHIP
+        // Set the pitch register = Vx.
+        // The audio pattern plays at 4000 * 2^((Vx - 64) / 48) samples a second.
+        case 0x003A:
+            chip8->reg.pitch = chip8->reg.V[x];
+        break;
     }
 }
 void exec_3(struct chip8* chip8, unsigned short opcode){
@@ -323,8 +350,8 @@ void exec_2(struct chip8* chip8, unsigned short opcode){
         // The interpreter generates a random number from 0 to 255, 
         // which is then ANDed with the value kk. The results are stored in Vx. See instruction 8xy2 for more information on AND.
         case 0xC000:
-            srand(clock());
-            chip8->reg.V[x] = (rand() % 255) & kk;
+            // 0 to 254, see chip8_random()
+            chip8->reg.V[x] = (chip8_random(chip8) % 255) & kk;
         break;
         // Dxyn - DRW Vx, Vy, nibble
         // Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
@@ -335,9 +362,16 @@ void exec_2(struct chip8* chip8, unsigned short opcode){
         // See instruction 8xy3 for more information on XOR, and section 2.4, Display, for more information on the Chip-8 screen and sprites.
 
         // n = height of sprite
+        // Dxy0 - DRW Vx, Vy, 0 (SUPER-CHIP)
+        // Display the 16x16 sprite at I, 2 bytes per row, the same way.
         case 0xD000: 
             // draw sprite function returns true is there is collision, thus setting V[15] to 1
-            chip8->reg.V[15] = draw_sprite(&chip8->screen, chip8->reg.V[x], chip8->reg.V[y], (const char*) &chip8->mem.memory_array[chip8->reg.I], n);
+            if(n == 0){
+                chip8->reg.V[15] = draw_large_sprite(&chip8->screen, chip8->reg.V[x], chip8->reg.V[y], (const char*) &chip8->mem.memory_array[chip8->reg.I]);
+            }
+            else{
+                chip8->reg.V[15] = draw_sprite(&chip8->screen, chip8->reg.V[x], chip8->reg.V[y], (const char*) &chip8->mem.memory_array[chip8->reg.I], n);
+            }
         break;
         // keyboard operation
         case 0xE000:
@@ -366,8 +400,8 @@ void exec_2(struct chip8* chip8, unsigned short opcode){
         break;
     }
 }
-// implementation of opcodes
-void exec(struct chip8* chip8, unsigned short opcode){
+// implementation of opcodes as one big switch, kept as the reference that the dispatch table in dispatch.c is checked against
+void exec_switch(struct chip8* chip8, unsigned short opcode){
     switch(opcode){
         // 00E0 - CLS
         // clear the screen
@@ -379,8 +413,105 @@ void exec(struct chip8* chip8, unsigned short opcode){
         case 0x00EE:
             chip8->reg.program_counter = pop(chip8);
         break;
+        // SUPER-CHIP display instructions, the scrolls are in pixels of the mode the screen is in
+        // 00FB - SCR
+        // Scroll the display right by 4 pixels.
+        case 0x00FB:
+            scroll_right(&chip8->screen, 4);
+        break;
+        // 00FC - SCL
+        // Scroll the display left by 4 pixels.
+        case 0x00FC:
+            scroll_left(&chip8->screen, 4);
+        break;
+        // 00FE - LOW
+        // Go back to the 64x32 display.
+        case 0x00FE:
+            screen_set_hires(&chip8->screen, false);
+        break;
+        // 00FF - HIGH
+        // Switch to the 128x64 display.
+        case 0x00FF:
+            screen_set_hires(&chip8->screen, true);
+        break;
 
         default: 
+            // 00Cn - SCD nibble
+            // Scroll the display down by n pixels.
+            if((opcode & 0xfff0) == 0x00C0){
+                scroll_down(&chip8->screen, opcode & 0x000f);
+                break;
+            }
             exec_2(chip8, opcode);
     }
-}
\ No newline at end of file
+}
+// runs an opcode through the dispatch table, behaves the same as exec_switch() without going through the nested switches
+void exec(struct chip8* chip8, unsigned short opcode){
+    run_instruction(chip8, decode(opcode));
+}
+// fetches the instruction at the program counter from the decoded cache, moves the program counter past it and runs it
+void step(struct chip8* chip8){
+    const struct instruction* ins = memory_get_instruction(&chip8->mem, chip8->reg.program_counter);
+    chip8->reg.program_counter += 2;
+    run_instruction(chip8, ins);
+}
+void step_single(struct chip8* chip8){
+    unsigned short pc = chip8->reg.program_counter;
+    assert(pc < 4096);
+    unsigned char* memory = chip8->mem.memory_array;
+    chip8->reg.program_counter += 2;
+    // the second byte at 0xFFF wraps around to 0 the same as in memory_get_instruction()
+    run_instruction(chip8, decode(memory[pc] << 8 | memory[(pc + 1) & 0x0fff]));
+}
+// why chip8_run() stops after each kind of handler, RUN_DONE for the ones it carries on after. RUN_KEY only stops it
+// when the Fx0A did start waiting
+static const unsigned char handler_stops[HANDLER_COUNT] = {
+    [1 + OP_CLS] = RUN_DRAW, [1 + OP_DRW] = RUN_DRAW, [1 + OP_DRW_LARGE] = RUN_DRAW,
+    // the SUPER-CHIP scrolls and mode switches
+    [1 + OP_SCD] = RUN_DRAW, [1 + OP_SCR] = RUN_DRAW, [1 + OP_SCL] = RUN_DRAW, [1 + OP_LOW] = RUN_DRAW, [1 + OP_HIGH] = RUN_DRAW,
+    [HANDLER_FUSED + FUSION_LD_I_DRW] = RUN_DRAW,
+    [1 + OP_LD_DT_VX] = RUN_TIMER, [1 + OP_LD_ST_VX] = RUN_TIMER,
+    [1 + OP_AUDIO] = RUN_SOUND, [1 + OP_PITCH] = RUN_SOUND,
+    [1 + OP_LD_VX_K] = RUN_KEY
+};
+// the main loop for frontends, the same as step() over and over but with the checks for when to stop
+enum run_stop chip8_run(struct chip8* chip8, long count, long* ran){
+    struct instruction* decoded = chip8->mem.decoded;
+    enum run_stop stop = RUN_DONE;
+    // a fused instruction (see fusion.c) counts for every instruction in it
+    unsigned long extra = chip8->fusion.extra;
+    long done = 0;
+    if(keyboard_waiting(&chip8->keyboard)){
+        stop = RUN_KEY;
+        count = 0;
+    }
+    while(done < count){
+        // the address is masked to 12 bits instead of going through the asserts in memory_get_instruction()
+        unsigned short pc = chip8->reg.program_counter & 0x0fff;
+        const struct instruction* ins = &decoded[pc];
+        if(!ins->handler){
+            ins = memory_get_instruction(&chip8->mem, pc);
+        }
+        // a fused sequence is 3 instructions at most, near the end of count only its first one runs so it can't go past
+        if(ins->handler >= HANDLER_FUSED && count - done < 3){
+            unsigned char* memory = chip8->mem.memory_array;
+            ins = decode(memory[pc] << 8 | memory[(pc + 1) & 0x0fff]);
+        }
+        unsigned char handler = ins->handler;
+        chip8->reg.program_counter += 2;
+        run_instruction(chip8, ins);
+        done += 1 + (chip8->fusion.extra - extra);
+        extra = chip8->fusion.extra;
+        stop = handler_stops[handler];
+        if(stop == RUN_KEY && !keyboard_waiting(&chip8->keyboard)){
+            stop = RUN_DONE;
+        }
+        if(stop != RUN_DONE){
+            break;
+        }
+    }
+    if(ran){
+        *ran = done;
+    }
+    return stop;
+}
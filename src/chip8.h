@@ -6,16 +6,70 @@
 #include "stack.h"
 #include "keyboard.h"
 #include "screen.h"
+#include "block.h"
+#include "fusion.h"
 #include <stddef.h>
+#include <stdint.h>
 struct chip8{
     struct memory mem;
     struct registers reg;
     struct stack stack;
     struct keyboard keyboard;
     struct screen screen;
+    struct block_cache blocks;
+    struct fusion_stats fusion;
+    // state of the xorshift generator Cxkk takes its numbers from, see chip8_random()
+    uint32_t random;
 };
 
+// why chip8_run() handed control back
+// chip8_run() reads the instructions out of the decoded cache (see memory.h) at the program counter masked to 12
+// bits, it does not fetch and check two bytes of memory every time the way step_single() does. the decoded entries
+// are kept in sync with memory, so it runs the same instructions either way. the timers tick outside of it, the
+// caller's count is what ends a tick, RUN_TIMER is only for an instruction that sets one of them
+enum run_stop{
+    // ran all the instructions it was asked to, the end of a tick when count was what was left of it
+    RUN_DONE,
+    // the last instruction changed the screen (00E0, Dxyn or one of the SUPER-CHIP scrolls and mode switches)
+    RUN_DRAW,
+    // an Fx0A is waiting for a key, nothing runs until the wait is over (see keyboard_waiting())
+    RUN_KEY,
+    // the last instruction set the delay or the sound timer (Fx15 or Fx18)
+    RUN_TIMER,
+    // the last instruction changed the XO-CHIP sound (F002 or Fx3A)
+    RUN_SOUND
+};
+
+// what init() seeds the random numbers with, a run of a rom is the same every time unless chip8_seed() picks another
+#define CHIP8_DEFAULT_SEED 0x2545f491
+
 void init(struct chip8* chip8);
+// starts Cxkk's random numbers over from seed, 0 is the one seed xorshift can't use and picks CHIP8_DEFAULT_SEED
+void chip8_seed(struct chip8* chip8, uint32_t seed);
 void exec(struct chip8* chip8, unsigned short opcode);
+void exec_switch(struct chip8* chip8, unsigned short opcode);
+// runs the next instruction, the same as exec() on the opcode at the program counter after moving the program counter by 2
+void step(struct chip8* chip8);
+// the same as step() but always one instruction, a fused sequence starting at the program counter is run as its first
+// instruction only. for the last few instructions before a count runs out
+void step_single(struct chip8* chip8);
+// runs count instructions or until one of the stops in enum run_stop, ran (if not 0) gets how many were run. it never
+// goes past count, a fused sequence (see fusion.c) that would is run one instruction at a time
+enum run_stop chip8_run(struct chip8* chip8, long count, long* ran);
 void load(struct chip8* chip8, const char* buffer, size_t size);
+
+// the next random number for Cxkk, every core takes them from here so they all draw the same ones. Cxkk takes it
+// % 255 like it always took rand(), so the byte is 0 to 254 and not the 0 to 255 the spec says, kept that way so
+// the range roms see doesn't change along with the generator
+static inline uint32_t chip8_random(struct chip8* chip8){
+    uint32_t x = chip8->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    chip8->random = x;
+    return x;
+}
+// Fx0A, returns the key that ended the wait. until there is one the keyboard is left waiting and the program counter
+// is moved back so Fx0A runs again
+char wait_for_key_press(struct chip8* chip8);
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "cores.h"
+#include "chip8.h"
+#include "block.h"
+#include "threaded.h"
+#include "jit.h"
+#include <string.h>
+#include <assert.h>
+
+static long run_switch(struct chip8* chip8, long count){
+    unsigned char* memory = chip8->mem.memory_array;
+    long i = 0;
+    while(i < count && !keyboard_waiting(&chip8->keyboard)){
+        // the second byte at 0xFFF wraps around to 0 the same as in memory_get_instruction()
+        unsigned short pc = chip8->reg.program_counter;
+        assert(pc < 4096);
+        unsigned short opcode = memory[pc] << 8 | memory[(pc + 1) & 0x0fff];
+        chip8->reg.program_counter += 2;
+        exec_switch(chip8, opcode);
+        i += 1;
+    }
+    return i;
+}
+// a fused instruction is one step() but up to 3 instructions, fusion.extra has the ones on top. the last 2 before count
+// go through step_single() so a fused one can't take it past count
+static long run_table(struct chip8* chip8, long count){
+    unsigned long extra = chip8->fusion.extra;
+    long steps = 0;
+    long done = 0;
+    while(done < count - 2 && !keyboard_waiting(&chip8->keyboard)){
+        step(chip8);
+        steps += 1;
+        done = steps + (long)(chip8->fusion.extra - extra);
+    }
+    while(done < count && !keyboard_waiting(&chip8->keyboard)){
+        step_single(chip8);
+        done += 1;
+    }
+    return done;
+}
+// chip8_run() hands back on every draw and timer write, so it gets called again until the count is used up
+static long run_batched(struct chip8* chip8, long count){
+    long done = 0;
+    while(done < count && !keyboard_waiting(&chip8->keyboard)){
+        long ran;
+        chip8_run(chip8, count - done, &ran);
+        done += ran;
+    }
+    return done;
+}
+static long run_blocks(struct chip8* chip8, long count){
+    return exec_blocks(chip8, count);
+}
+static long run_threaded(struct chip8* chip8, long count){
+    return exec_threaded(chip8, count);
+}
+
+// the translated code belongs to one chip8, it is made again for another one and thrown away when a rom is loaded
+static struct jit* jit;
+static void start_jit(struct chip8* chip8){
+    if(jit && jit->chip8 != chip8){
+        jit_destroy(jit);
+        jit = 0;
+    }
+    if(jit){
+        jit_flush(jit);
+    }
+    else{
+        jit = jit_create(chip8);
+    }
+}
+static long run_jit(struct chip8* chip8, long count){
+    // not an x86-64 host or no executable memory, chip8_run() does it instead
+    if(!jit){
+        return run_batched(chip8, count);
+    }
+    return jit_run(jit, count);
+}
+
+const struct core cores[] = {
+    {"switch", run_switch},
+    {"table", run_table},
+    {"run", run_batched},
+    {"blocks", run_blocks},
+    {"threaded", run_threaded},
+    {"jit", run_jit, start_jit},
+};
+const int core_count = sizeof(cores) / sizeof(cores[0]);
+
+const struct core* core_find(const char* name){
+    for(int i = 0; i < core_count; i++){
+        if(strcmp(cores[i].name, name) == 0){
+            return &cores[i];
+        }
+    }
+    return 0;
+}
+
+void core_start(const struct core* core, struct chip8* chip8){
+    if(core->start){
+        core->start(chip8);
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef CORES_H
+#define CORES_H
+
+struct chip8;
+
+// the ways there are of running instructions, by name, for the tools that let you pick one or go through all of them
+struct core{
+    const char* name;
+    // runs up to count instructions and returns how many were run, it stops early when an Fx0A starts waiting.
+    // some go a little past count, chip8_run() finishes fused sequences and exec_blocks() whole blocks
+    long (*run)(struct chip8* chip8, long count);
+    // 0 for the cores that keep nothing of their own, otherwise it has to be called through core_start() every time a
+    // rom is loaded into chip8 before the core runs it
+    void (*start)(struct chip8* chip8);
+};
+
+// exec_switch() is first, the others are checked against it by bin/lockstep
+extern const struct core cores[];
+extern const int core_count;
+
+// 0 if there is no core called name
+const struct core* core_find(const char* name);
+// after init() and load()
+void core_start(const struct core* core, struct chip8* chip8);
+
+#endif
@@ -0,0 +1,308 @@
+#include "dispatch.h"
+#include "chip8.h"
+#include <stdbool.h>
+
+// one entry for every possible opcode, the handler and operands are worked out once in dispatch_init()
+// so running an instruction is a single indirect call instead of going through exec -> exec_2 -> exec_3/exec_4
+struct instruction dispatch_table[0x10000];
+static bool dispatch_ready = false;
+
+// the handlers below must behave exactly like the switch in exec_switch(), see chip8.c for the full description of each opcode
+
+// 0nnn - SYS addr and any opcode the switch does not know about, ignored
+static void op_nop(struct chip8* chip8, const struct instruction* ins){
+}
+// 00E0 - CLS
+static void op_cls(struct chip8* chip8, const struct instruction* ins){
+    clear(&chip8->screen);
+}
+// 00EE - RET
+static void op_ret(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.program_counter = pop(chip8);
+}
+// 1nnn - JP addr
+static void op_jp(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.program_counter = ins->nnn;
+}
+// 2nnn - CALL addr
+static void op_call(struct chip8* chip8, const struct instruction* ins){
+    push(chip8, chip8->reg.program_counter);
+    chip8->reg.program_counter = ins->nnn;
+}
+// 3xkk - SE Vx, byte
+static void op_se_byte(struct chip8* chip8, const struct instruction* ins){
+    if(chip8->reg.V[ins->x] == ins->kk){
+        chip8->reg.program_counter += 2;
+    }
+}
+// 4xkk - SNE Vx, byte
+static void op_sne_byte(struct chip8* chip8, const struct instruction* ins){
+    if(chip8->reg.V[ins->x] != ins->kk){
+        chip8->reg.program_counter += 2;
+    }
+}
+// 5xy0 - SE Vx, Vy
+static void op_se_reg(struct chip8* chip8, const struct instruction* ins){
+    if(chip8->reg.V[ins->x] == chip8->reg.V[ins->y]){
+        chip8->reg.program_counter += 2;
+    }
+}
+// 6xkk - LD Vx, byte
+static void op_ld_byte(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] = ins->kk;
+}
+// 7xkk - ADD Vx, byte
+static void op_add_byte(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] += ins->kk;
+}
+// 8xy0 - LD Vx, Vy
+static void op_ld_reg(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] = chip8->reg.V[ins->y];
+}
+// 8xy1 - OR Vx, Vy
+static void op_or(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] |= chip8->reg.V[ins->y];
+}
+// 8xy2 - AND Vx, Vy
+static void op_and(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] &= chip8->reg.V[ins->y];
+}
+// 8xy3 - XOR Vx, Vy
+static void op_xor(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] ^= chip8->reg.V[ins->y];
+}
+// 8xy4 - ADD Vx, Vy
+// VF is written before Vx, so when x is F the sum wins over the carry
+static void op_add_reg(struct chip8* chip8, const struct instruction* ins){
+    unsigned short tmp = chip8->reg.V[ins->x] + chip8->reg.V[ins->y];
+    chip8->reg.V[15] = tmp > 0xff;
+    chip8->reg.V[ins->x] = tmp;
+}
+// 8xy5 - SUB Vx, Vy
+static void op_sub(struct chip8* chip8, const struct instruction* ins){
+    unsigned char tmp = chip8->reg.V[ins->x] - chip8->reg.V[ins->y];
+    chip8->reg.V[15] = chip8->reg.V[ins->x] > chip8->reg.V[ins->y];
+    chip8->reg.V[ins->x] = tmp;
+}
+// 8xy6 - SHR Vx {, Vy}
+static void op_shr(struct chip8* chip8, const struct instruction* ins){
+    unsigned char tmp = chip8->reg.V[ins->x] / 2;
+    chip8->reg.V[15] = chip8->reg.V[ins->x] & 0x01;
+    chip8->reg.V[ins->x] = tmp;
+}
+// 8xy7 - SUBN Vx, Vy
+static void op_subn(struct chip8* chip8, const struct instruction* ins){
+    unsigned char tmp = chip8->reg.V[ins->y] - chip8->reg.V[ins->x];
+    chip8->reg.V[15] = chip8->reg.V[ins->y] > chip8->reg.V[ins->x];
+    chip8->reg.V[ins->x] = tmp;
+}
+// 8xyE - SHL Vx {, Vy}
+// the check in exec_3() is written as V[x] & (0x80 == 1), so VF always ends up 0
+static void op_shl(struct chip8* chip8, const struct instruction* ins){
+    unsigned char tmp = chip8->reg.V[ins->x] * 2;
+    chip8->reg.V[15] = 0;
+    chip8->reg.V[ins->x] = tmp;
+}
+// 9xy0 - SNE Vx, Vy
+static void op_sne_reg(struct chip8* chip8, const struct instruction* ins){
+    if(chip8->reg.V[ins->x] != chip8->reg.V[ins->y]){
+        chip8->reg.program_counter += 2;
+    }
+}
+// Annn - LD I, addr
+static void op_ld_i(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.I = ins->nnn;
+}
+// Bnnn - JP V0, addr
+static void op_jp_v0(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.program_counter = ins->nnn + chip8->reg.V[0];
+}
+// Cxkk - RND Vx, byte
+static void op_rnd(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] = (chip8_random(chip8) % 255) & ins->kk;
+}
+// Dxyn - DRW Vx, Vy, nibble
+static void op_drw(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[15] = draw_sprite(&chip8->screen, chip8->reg.V[ins->x], chip8->reg.V[ins->y], (const char*) &chip8->mem.memory_array[chip8->reg.I], ins->n);
+}
+// Fx07 - LD Vx, DT
+static void op_ld_vx_dt(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] = delay_timer_get(&chip8->reg);
+}
+// Fx0A - LD Vx, K
+static void op_ld_vx_k(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[ins->x] = wait_for_key_press(chip8);
+}
+// Fx15 - LD DT, Vx
+static void op_ld_dt_vx(struct chip8* chip8, const struct instruction* ins){
+    delay_timer_set(&chip8->reg, chip8->reg.V[ins->x]);
+}
+// Fx18 - LD ST, Vx
+static void op_ld_st_vx(struct chip8* chip8, const struct instruction* ins){
+    sound_timer_set(&chip8->reg, chip8->reg.V[ins->x]);
+}
+// Fx1E - ADD I, Vx
+static void op_add_i(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.I += chip8->reg.V[ins->x];
+}
+// Fx29 - LD F, Vx
+static void op_ld_f(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.I = chip8->reg.V[ins->x] * 5;
+}
+// Fx33 - LD B, Vx
+static void op_ld_b(struct chip8* chip8, const struct instruction* ins){
+    memory_set(&chip8->mem, chip8->reg.I, chip8->reg.V[ins->x] / 100);
+    memory_set(&chip8->mem, chip8->reg.I+1, chip8->reg.V[ins->x] / 10 % 10);
+    memory_set(&chip8->mem, chip8->reg.I+2, chip8->reg.V[ins->x] % 10);
+}
+// Fx55 - LD [I], Vx
+// same as exec_4(), every byte gets the value of Vx
+static void op_ld_mem_vx(struct chip8* chip8, const struct instruction* ins){
+    for(int i = 0; i <= ins->x; i++){
+        memory_set(&chip8->mem, chip8->reg.I+i, chip8->reg.V[ins->x]);
+    }
+}
+// Fx65 - LD Vx, [I]
+static void op_ld_vx_mem(struct chip8* chip8, const struct instruction* ins){
+    for(int i = 0; i <= ins->x; i++){
+        chip8->reg.V[i] = memory_get(&chip8->mem, chip8->reg.I+i);
+    }
+}
+
+// 00Cn - SCD nibble, SUPER-CHIP
+static void op_scd(struct chip8* chip8, const struct instruction* ins){
+    scroll_down(&chip8->screen, ins->n);
+}
+// 00FB - SCR, SUPER-CHIP
+static void op_scr(struct chip8* chip8, const struct instruction* ins){
+    scroll_right(&chip8->screen, 4);
+}
+// 00FC - SCL, SUPER-CHIP
+static void op_scl(struct chip8* chip8, const struct instruction* ins){
+    scroll_left(&chip8->screen, 4);
+}
+// 00FE - LOW, SUPER-CHIP
+static void op_low(struct chip8* chip8, const struct instruction* ins){
+    screen_set_hires(&chip8->screen, false);
+}
+// 00FF - HIGH, SUPER-CHIP
+static void op_high(struct chip8* chip8, const struct instruction* ins){
+    screen_set_hires(&chip8->screen, true);
+}
+// Dxy0 - DRW Vx, Vy, 0, SUPER-CHIP, a 16x16 sprite
+static void op_drw_large(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.V[15] = draw_large_sprite(&chip8->screen, chip8->reg.V[ins->x], chip8->reg.V[ins->y], (const char*) &chip8->mem.memory_array[chip8->reg.I]);
+}
+
+// F002 - AUDIO, XO-CHIP, loads the 16 byte audio pattern from [I]
+static void op_audio(struct chip8* chip8, const struct instruction* ins){
+    for(int i = 0; i < 16; i++){
+        chip8->reg.pattern[i] = memory_get(&chip8->mem, chip8->reg.I+i);
+    }
+    chip8->reg.pattern_version += 1;
+}
+// Fx3A - PITCH Vx, XO-CHIP
+static void op_pitch(struct chip8* chip8, const struct instruction* ins){
+    chip8->reg.pitch = chip8->reg.V[ins->x];
+}
+
+instruction_handler instruction_handlers[HANDLER_COUNT];
+
+// handlers in the same order as enum opcode_kind
+static const instruction_handler handlers[OP_COUNT] = {
+    op_nop, op_cls, op_ret, op_jp, op_call, op_se_byte, op_sne_byte, op_se_reg, op_ld_byte, op_add_byte,
+    op_ld_reg, op_or, op_and, op_xor, op_add_reg, op_sub, op_shr, op_subn, op_shl, op_sne_reg,
+    op_ld_i, op_jp_v0, op_rnd, op_drw, op_ld_vx_dt, op_ld_vx_k, op_ld_dt_vx, op_ld_st_vx, op_add_i, op_ld_f,
+    op_ld_b, op_ld_mem_vx, op_ld_vx_mem,
+    op_scd, op_scr, op_scl, op_low, op_high, op_drw_large,
+    op_audio, op_pitch
+};
+
+// mirrors the case labels of exec_switch() and the functions it calls
+enum opcode_kind opcode_kind(unsigned short opcode){
+    if(opcode == 0x00E0){
+        return OP_CLS;
+    }
+    if(opcode == 0x00EE){
+        return OP_RET;
+    }
+    if((opcode & 0xfff0) == 0x00C0){
+        return OP_SCD;
+    }
+    switch(opcode){
+        case 0x00FB: return OP_SCR;
+        case 0x00FC: return OP_SCL;
+        case 0x00FE: return OP_LOW;
+        case 0x00FF: return OP_HIGH;
+    }
+    switch(opcode & 0xf000){
+        case 0x1000: return OP_JP;
+        case 0x2000: return OP_CALL;
+        case 0x3000: return OP_SE_BYTE;
+        case 0x4000: return OP_SNE_BYTE;
+        // exec_2() does not look at the lowest nibble for 5xy0 and 9xy0
+        case 0x5000: return OP_SE_REG;
+        case 0x6000: return OP_LD_BYTE;
+        case 0x7000: return OP_ADD_BYTE;
+        case 0x8000:
+            switch(opcode & 0x000f){
+                case 0x0000: return OP_LD_REG;
+                case 0x0001: return OP_OR;
+                case 0x0002: return OP_AND;
+                case 0x0003: return OP_XOR;
+                case 0x0004: return OP_ADD_REG;
+                case 0x0005: return OP_SUB;
+                case 0x0006: return OP_SHR;
+                case 0x0007: return OP_SUBN;
+                case 0x000E: return OP_SHL;
+            }
+        break;
+        case 0x9000: return OP_SNE_REG;
+        case 0xA000: return OP_LD_I;
+        case 0xB000: return OP_JP_V0;
+        case 0xC000: return OP_RND;
+        case 0xD000: return (opcode & 0x000f) == 0 ? OP_DRW_LARGE : OP_DRW;
+        // Ex9E and ExA1 are compared as opcode & (0x00ff == 0x009e) in exec_2(), which is always 0, so neither one ever skips
+        case 0xE000: return OP_NOP;
+        case 0xF000:
+            switch(opcode & 0x00ff){
+                case 0x0007: return OP_LD_VX_DT;
+                case 0x000A: return OP_LD_VX_K;
+                case 0x0015: return OP_LD_DT_VX;
+                case 0x0018: return OP_LD_ST_VX;
+                case 0x001E: return OP_ADD_I;
+                case 0x0029: return OP_LD_F;
+                case 0x0033: return OP_LD_B;
+                case 0x0055: return OP_LD_MEM_VX;
+                case 0x0065: return OP_LD_VX_MEM;
+                case 0x003A: return OP_PITCH;
+            }
+            if(opcode == 0xF002){
+                return OP_AUDIO;
+            }
+        break;
+    }
+    return OP_NOP;
+}
+
+void dispatch_init(void){
+    if(dispatch_ready){
+        return;
+    }
+    for(int kind = 0; kind < OP_COUNT; kind++){
+        instruction_handlers[1 + kind] = handlers[kind];
+    }
+    for(int kind = 0; kind < FUSION_COUNT; kind++){
+        instruction_handlers[HANDLER_FUSED + kind] = fusion_handlers[kind];
+    }
+    for(int opcode = 0; opcode < 0x10000; opcode++){
+        struct instruction* ins = &dispatch_table[opcode];
+        ins->handler = 1 + opcode_kind(opcode);
+        ins->nnn = opcode & 0x0fff;
+        ins->x = (opcode >> 8) & 0x000f;
+        ins->y = (opcode >> 4) & 0x000f;
+        ins->kk = opcode & 0x00ff;
+        ins->n = opcode & 0x000f;
+    }
+    dispatch_ready = true;
+}
@@ -0,0 +1,37 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "instruction.h"
+#include "fusion.h"
+
+// every distinct thing an opcode can do, one per handler in dispatch.c
+enum opcode_kind{
+    OP_NOP, OP_CLS, OP_RET, OP_JP, OP_CALL, OP_SE_BYTE, OP_SNE_BYTE, OP_SE_REG, OP_LD_BYTE, OP_ADD_BYTE,
+    OP_LD_REG, OP_OR, OP_AND, OP_XOR, OP_ADD_REG, OP_SUB, OP_SHR, OP_SUBN, OP_SHL, OP_SNE_REG,
+    OP_LD_I, OP_JP_V0, OP_RND, OP_DRW, OP_LD_VX_DT, OP_LD_VX_K, OP_LD_DT_VX, OP_LD_ST_VX, OP_ADD_I, OP_LD_F,
+    OP_LD_B, OP_LD_MEM_VX, OP_LD_VX_MEM,
+    // SUPER-CHIP
+    OP_SCD, OP_SCR, OP_SCL, OP_LOW, OP_HIGH, OP_DRW_LARGE,
+    // XO-CHIP
+    OP_AUDIO, OP_PITCH,
+    OP_COUNT
+};
+
+// the index in struct instruction of the handler for a kind of opcode is 1 + its enum opcode_kind, the fused
+// instructions come after them at HANDLER_FUSED + their enum fusion_kind
+#define HANDLER_FUSED (1 + OP_COUNT)
+#define HANDLER_COUNT (HANDLER_FUSED + FUSION_COUNT)
+
+// builds the table that maps each of the 65536 opcodes to its handler, only does the work on the first call
+void dispatch_init(void);
+// filled by dispatch_init(), use decode() to look things up in it
+extern struct instruction dispatch_table[0x10000];
+
+// looks up the decoded form of an opcode, dispatch_init() must have been called before
+static inline const struct instruction* decode(unsigned short opcode){
+    return &dispatch_table[opcode];
+}
+// works out which kind of instruction an opcode is, the same way exec_switch() does
+enum opcode_kind opcode_kind(unsigned short opcode);
+
+#endif
@@ -0,0 +1,97 @@
+#include "fusion.h"
+#include "chip8.h"
+#include "dispatch.h"
+
+// a fused instruction is started like any other, so the program counter already points past its first instruction
+// the operand fields of ins don't hold the operands of the first opcode anymore, each handler says what they hold
+
+// Annn; Dxyn - nnn is the address for I, x, y and n come from the Dxyn
+static void op_ld_i_drw(struct chip8* chip8, const struct instruction* ins){
+    chip8->fusion.fired[FUSION_LD_I_DRW] += 1;
+    chip8->fusion.extra += 1;
+    chip8->reg.I = ins->nnn;
+    // the draw itself goes through its normal handler so it stays exactly the same as on its own
+    const struct instruction* draw = decode(0xD000 | ins->x << 8 | ins->y << 4 | ins->n);
+    run_instruction(chip8, draw);
+    chip8->reg.program_counter += 2;
+}
+// 6xkk; 6ykk - x and kk for the first load, y and n for the second
+static void op_ld_ld(struct chip8* chip8, const struct instruction* ins){
+    chip8->fusion.fired[FUSION_LD_LD] += 1;
+    chip8->fusion.extra += 1;
+    chip8->reg.V[ins->x] = ins->kk;
+    chip8->reg.V[ins->y] = ins->n;
+    chip8->reg.program_counter += 2;
+}
+// 7xkk; 3ykk; 1nnn - x and kk for the add, y and n for the compare, nnn where the jump goes
+static void op_add_se_jp(struct chip8* chip8, const struct instruction* ins){
+    chip8->fusion.fired[FUSION_ADD_SE_JP] += 1;
+    chip8->reg.V[ins->x] += ins->kk;
+    if(chip8->reg.V[ins->y] == ins->n){
+        // the compare skips the jump, so only 2 instructions were run
+        chip8->fusion.extra += 1;
+        chip8->reg.program_counter += 4;
+    }
+    else{
+        chip8->fusion.extra += 2;
+        chip8->reg.program_counter = ins->nnn;
+    }
+}
+// Fx07; 3ykk; 1nnn - x for the timer read, y and n for the compare, nnn where the jump goes
+static void op_dt_se_jp(struct chip8* chip8, const struct instruction* ins){
+    chip8->fusion.fired[FUSION_DT_SE_JP] += 1;
+    chip8->reg.V[ins->x] = delay_timer_get(&chip8->reg);
+    if(chip8->reg.V[ins->y] == ins->n){
+        chip8->fusion.extra += 1;
+        chip8->reg.program_counter += 4;
+    }
+    else{
+        chip8->fusion.extra += 2;
+        chip8->reg.program_counter = ins->nnn;
+    }
+}
+
+const instruction_handler fusion_handlers[FUSION_COUNT] = {op_ld_i_drw, op_ld_ld, op_add_se_jp, op_dt_se_jp};
+
+void fuse(struct memory* mem, int address, struct instruction* ins){
+    // every sequence is at least 2 instructions, the 3 instruction ones check for room themselves
+    if(address + 3 >= 4096){
+        return;
+    }
+    unsigned short first = memory_get_short(mem, address);
+    unsigned short second = memory_get_short(mem, address + 2);
+    unsigned short third = address + 5 < 4096 ? memory_get_short(mem, address + 4) : 0;
+    bool se_jp = (second & 0xf000) == 0x3000 && (third & 0xf000) == 0x1000;
+
+    if((first & 0xf000) == 0xA000 && (second & 0xf000) == 0xD000){
+        ins->handler = HANDLER_FUSED + FUSION_LD_I_DRW;
+        ins->x = (second >> 8) & 0x000f;
+        ins->y = (second >> 4) & 0x000f;
+        ins->n = second & 0x000f;
+    }
+    else if((first & 0xf000) == 0x6000 && (second & 0xf000) == 0x6000){
+        ins->handler = HANDLER_FUSED + FUSION_LD_LD;
+        ins->y = (second >> 8) & 0x000f;
+        ins->n = second & 0x00ff;
+    }
+    else if((first & 0xf000) == 0x7000 && se_jp){
+        ins->handler = HANDLER_FUSED + FUSION_ADD_SE_JP;
+        ins->y = (second >> 8) & 0x000f;
+        ins->n = second & 0x00ff;
+        ins->nnn = third & 0x0fff;
+    }
+    else if((first & 0xf0ff) == 0xF007 && se_jp){
+        ins->handler = HANDLER_FUSED + FUSION_DT_SE_JP;
+        ins->y = (second >> 8) & 0x000f;
+        ins->n = second & 0x00ff;
+        ins->nnn = third & 0x0fff;
+    }
+}
+
+const char* fusion_name(enum fusion_kind kind){
+    static const char* names[FUSION_COUNT] = {"Annn;Dxyn", "6xkk;6ykk", "7xkk;3ykk;1nnn", "Fx07;3ykk;1nnn"};
+    return names[kind];
+}
+bool fusion_draws(const struct instruction* ins){
+    return ins->handler == HANDLER_FUSED + FUSION_LD_I_DRW;
+}
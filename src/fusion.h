@@ -0,0 +1,39 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include "instruction.h"
+#include <stdbool.h>
+
+struct memory;
+
+// sequences of instructions that show up all the time in chip8 games and get run as a single instruction
+enum fusion_kind{
+    // Annn; Dxyn - point I at a sprite and draw it
+    FUSION_LD_I_DRW,
+    // 6xkk; 6ykk - load two registers, usually a pair of coordinates
+    FUSION_LD_LD,
+    // 7xkk; 3ykk; 1nnn - add to a counter, leave the loop once it hits a value
+    FUSION_ADD_SE_JP,
+    // Fx07; 3ykk; 1nnn - read the delay timer and keep waiting until it hits a value
+    FUSION_DT_SE_JP,
+    FUSION_COUNT
+};
+
+// how many times each fused instruction has run
+struct fusion_stats{
+    unsigned long fired[FUSION_COUNT];
+    // instructions that were run as part of a fused one on top of the first, so the real instruction count can be kept
+    unsigned long extra;
+};
+
+// the handlers of the fused instructions, in the order of enum fusion_kind
+extern const instruction_handler fusion_handlers[FUSION_COUNT];
+
+// called when the instruction at address has just been decoded into ins, if it starts one of the sequences above
+// the handler is swapped for the fused one and the operands of the whole sequence are packed into ins
+void fuse(struct memory* mem, int address, struct instruction* ins);
+const char* fusion_name(enum fusion_kind kind);
+// true if ins is a fused Annn; Dxyn, so running it draws even though its opcode is the Annn
+bool fusion_draws(const struct instruction* ins);
+
+#endif
@@ -0,0 +1,207 @@
+// bin/headless runs a rom without a window, sound or keyboard, for batch runs and ci
+//   headless [--frames n | --instructions n] [--ips n] [--seed n] [--core name] [--dump file] [--hashes]
+//            [--capture file] <rom file>
+//
+// a frame is one tick of the delay and sound timers, a 60th of --ips instructions (600 if it is not given) the same
+// as the SDL frontend. it runs 60 frames if nothing is given. --seed picks what Cxkk's random numbers start from,
+// CHIP8_DEFAULT_SEED if it is not given, so the same command always gives the same run. --core picks which of the
+// cores in cores.c runs the instructions, run (chip8_run()) if it is not given. they all end a tick on the same
+// instruction, so every core gives the same --hashes.
+// a build with make AOT=1 runs the roms in AOT_ROMS on the code bin/aot compiled them to, unless --core is given.
+// --dump writes the screen as it is at the end as a plain pbm image, - for stdout.
+// --hashes prints the frame number and screen_hash() of every frame that is different from the one before it, which
+// is enough to check a run against a known good one without keeping the images. --capture records the same frames
+// into a capture file (see capture.h) timed at 60 frames a second
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "chip8.h"
+#include "idle.h"
+#include "capture.h"
+#include "scheduler.h"
+#include "cores.h"
+#include "aot.h"
+
+// the rom is loaded at 0x200 and load() wants it to end before the last byte of memory
+static char buffer[4096 - 0x200 - 1];
+static struct chip8 chip8;
+static struct capture_encoder encoder;
+static struct scheduler scheduler;
+
+// one tick worth of instructions, with skip set it stops early when the program is only waiting for the timers.
+// nobody presses keys here, a program waiting on Fx0A stays that way and only the timers go on
+static long run_frame(const struct core* core, struct scheduler* scheduler, struct chip8* chip8, bool skip){
+    long done = 0;
+    while(scheduler_due(scheduler) > 0 && !keyboard_waiting(&chip8->keyboard)){
+        if(skip && skip_idle(chip8) != IDLE_NONE){
+            break;
+        }
+        long ran = core->run(chip8, scheduler_due(scheduler));
+        scheduler_advance(scheduler, ran);
+        done += ran;
+    }
+    scheduler_tick(scheduler, chip8);
+    return done;
+}
+
+// plain pbm, 1 is a pixel that is on, at the size of the mode the screen is in
+static void dump_screen(struct screen* screen, FILE* out){
+    fprintf(out, "P1\n%d %d\n", screen_width(screen), screen_height(screen));
+    for(int y = 0; y < screen_height(screen); y++){
+        for(int x = 0; x < screen_width(screen); x++){
+            fputc(is_screen_set(screen, x, y) ? '1' : '0', out);
+        }
+        fputc('\n', out);
+    }
+}
+
+static int usage(void){
+    printf("usage: headless [--frames n | --instructions n] [--ips n] [--seed n] [--core name] [--dump file] [--hashes] [--capture file] <rom file>\n");
+    printf("cores:");
+    for(int i = 0; i < core_count; i++){
+        printf(" %s", cores[i].name);
+    }
+    printf("\n");
+    return -1;
+}
+
+int main(int argc, char** argv){
+    long frames = -1;
+    long instructions = -1;
+    long rate = SCHEDULER_DEFAULT_RATE;
+    uint32_t seed = CHIP8_DEFAULT_SEED;
+    const struct core* core = 0;
+    const char* dump = 0;
+    bool hashes = false;
+    const char* capture_name = 0;
+    const char* file_name = 0;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc){
+            frames = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--instructions") == 0 && i + 1 < argc){
+            instructions = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--ips") == 0 && i + 1 < argc){
+            rate = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc){
+            seed = strtoul(argv[++i], 0, 0);
+        }
+        else if(strcmp(argv[i], "--core") == 0 && i + 1 < argc){
+            core = core_find(argv[++i]);
+            if(!core){
+                return usage();
+            }
+        }
+        else if(strcmp(argv[i], "--dump") == 0 && i + 1 < argc){
+            dump = argv[++i];
+        }
+        else if(strcmp(argv[i], "--hashes") == 0){
+            hashes = true;
+        }
+        else if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc){
+            capture_name = argv[++i];
+        }
+        else if(argv[i][0] != '-' && !file_name){
+            file_name = argv[i];
+        }
+        else{
+            return usage();
+        }
+    }
+    if(!file_name || (frames >= 0 && instructions >= 0) || rate < 1){
+        return usage();
+    }
+    if(frames < 0 && instructions < 0){
+        frames = 60;
+    }
+
+    FILE* f = fopen(file_name, "rb");
+    if(!f){
+        fprintf(stderr, "failed to open %s\n", file_name);
+        return -1;
+    }
+    size_t size = fread(buffer, 1, sizeof(buffer), f);
+    bool too_big = fgetc(f) != EOF;
+    fclose(f);
+    if(too_big){
+        fprintf(stderr, "%s does not fit in memory\n", file_name);
+        return -1;
+    }
+#ifdef CHIP8_AOT
+    // the compiled rom goes through the same loop as the cores, its run is the same kind of function
+    static struct core compiled;
+    const struct aot_rom* rom = aot_find(buffer, size);
+    if(!core && rom){
+        compiled = (struct core){rom->name, rom->run, 0};
+        core = &compiled;
+        fprintf(stderr, "running the compiled %s\n", rom->name);
+    }
+#endif
+    if(!core){
+        core = core_find("run");
+    }
+    init(&chip8);
+    chip8_seed(&chip8, seed);
+    load(&chip8, buffer, size);
+    core_start(core, &chip8);
+    scheduler_init(&scheduler, rate);
+    FILE* capture = 0;
+    unsigned char record[CAPTURE_FRAME_MAX];
+    if(capture_name){
+        capture = fopen(capture_name, "wb");
+        if(!capture){
+            fprintf(stderr, "failed to open %s\n", capture_name);
+            return -1;
+        }
+        fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_SIZE, capture);
+        capture_encoder_init(&encoder);
+        // the blank screen the program starts with
+        fwrite(record, 1, capture_encode(&encoder, &chip8.screen, 0, record), capture);
+    }
+
+    long frames_run = 0;
+    long instructions_run = 0;
+    uint64_t last_hash = screen_hash(&chip8.screen);
+    clock_t start = clock();
+    // counting instructions means running the idle loops as well, a program that jumps to itself would never get there
+    // otherwise. the last frame can go a little past the count, chip8_run() finishes fused sequences. a program waiting
+    // for a key never runs another instruction, so that ends a count early
+    while(frames >= 0 ? frames_run < frames : instructions_run < instructions && !keyboard_waiting(&chip8.keyboard)){
+        instructions_run += run_frame(core, &scheduler, &chip8, frames >= 0);
+        frames_run += 1;
+        if(screen_hash(&chip8.screen) == last_hash){
+            continue;
+        }
+        last_hash = screen_hash(&chip8.screen);
+        if(hashes){
+            printf("%ld %016llx\n", frames_run, (unsigned long long)last_hash);
+        }
+        if(capture){
+            uint32_t time = frames_run * 1000 / 60;
+            fwrite(record, 1, capture_encode(&encoder, &chip8.screen, time, record), capture);
+        }
+    }
+    if(capture){
+        fclose(capture);
+    }
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%s: %ld frames, %ld instructions, %.3f s, screen %016llx%s\n", file_name, frames_run, instructions_run,
+        seconds, (unsigned long long)screen_hash(&chip8.screen), keyboard_waiting(&chip8.keyboard) ? ", waiting for a key" : "");
+
+    if(dump){
+        FILE* out = strcmp(dump, "-") == 0 ? stdout : fopen(dump, "w");
+        if(!out){
+            fprintf(stderr, "failed to open %s\n", dump);
+            return -1;
+        }
+        dump_screen(&chip8.screen, out);
+        if(out != stdout){
+            fclose(out);
+        }
+    }
+    return 0;
+}
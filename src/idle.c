@@ -0,0 +1,37 @@
+#include "idle.h"
+#include "chip8.h"
+
+enum idle_kind skip_idle(struct chip8* chip8){
+    unsigned short pc = chip8->reg.program_counter;
+    if(pc + 1 >= 4096){
+        return IDLE_NONE;
+    }
+    unsigned short first = memory_get_short(&chip8->mem, pc);
+    // 1nnn - JP to the same address
+    if(first == (0x1000 | pc)){
+        return IDLE_HALT;
+    }
+    if(pc + 5 >= 4096 || (first & 0xf0ff) != 0xF007){
+        return IDLE_NONE;
+    }
+    unsigned char x = (first >> 8) & 0x000f;
+    unsigned short second = memory_get_short(&chip8->mem, pc + 2);
+    unsigned short third = memory_get_short(&chip8->mem, pc + 4);
+    // Fx07; 3xkk; 1nnn with nnn pointing back at the Fx07, the compare has to be on the register that was just loaded
+    if((second & 0xff00) != (0x3000 | x << 8) || third != (0x1000 | pc)){
+        return IDLE_NONE;
+    }
+    unsigned char kk = second & 0x00ff;
+    unsigned char delay = delay_timer_get(&chip8->reg);
+    if(delay == kk){
+        // this time around the loop ends
+        return IDLE_NONE;
+    }
+    // however many times the loop goes around before the next tick, it ends on the Fx07 with Vx holding the timer
+    chip8->reg.V[x] = delay;
+    // the timer only ever counts down to 0, once it is past kk the loop never ends
+    if(delay < kk){
+        return IDLE_HALT;
+    }
+    return IDLE_DELAY;
+}
@@ -0,0 +1,20 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+struct chip8;
+
+// loops a program sits in while it waits, running them does nothing but burn host cpu
+enum idle_kind{
+    IDLE_NONE,
+    // Fx07; 3xkk; 1nnn back to the Fx07 - waits until the delay timer gets down to kk
+    IDLE_DELAY,
+    // 1nnn to itself, or a delay loop that can't end anymore - only the timers change from here on
+    IDLE_HALT
+};
+
+// looks at the instructions at the program counter, if they are one of the loops above the registers are set
+// to what the loop leaves them at until the delay timer next changes and the kind of loop is returned
+// nothing has to be run for the program until the timers tick again
+enum idle_kind skip_idle(struct chip8* chip8);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef INSTRUCTION_H
+#define INSTRUCTION_H
+
+struct chip8;
+struct instruction;
+
+// every opcode is run by one of these, the handler gets the operands already pulled out of the opcode
+typedef void (*instruction_handler)(struct chip8* chip8, const struct instruction* ins);
+
+// a decoded opcode, see section 3.0 of the reference for what nnn, x, y, kk and n mean
+// fused instructions (see fusion.c) reuse the fields for the operands of the whole sequence
+// it is kept to 8 bytes, every chip8 has one per address of memory (see memory.h). so the handler is an index and the
+// opcode isn't kept, it is in memory at the address the instruction was decoded from
+struct instruction{
+    // index into instruction_handlers[], 0 for an entry that has not been decoded yet
+    unsigned char handler;
+    // lower 4 bits of the high byte, a register index
+    unsigned char x;
+    // upper 4 bits of the low byte, a register index
+    unsigned char y;
+    // lowest 8 bits of the opcode, a byte value
+    unsigned char kk;
+    // lowest 4 bits of the opcode, a nibble. the fused instructions keep a whole byte in it
+    unsigned char n;
+    // lowest 12 bits of the opcode, an address
+    unsigned short nnn;
+};
+
+// every handler an instruction can have, by the index in struct instruction. filled by dispatch_init(), see
+// HANDLER_FUSED in dispatch.h for which index is which
+extern instruction_handler instruction_handlers[];
+
+static inline void run_instruction(struct chip8* chip8, const struct instruction* ins){
+    instruction_handlers[ins->handler](chip8, ins);
+}
+
+#endif
@@ -0,0 +1,447 @@
+#include "jit.h"
+#include "chip8.h"
+#include "dispatch.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// register use in translated code:
+// rbx holds the struct chip8 pointer for the whole run, so V0-VF, I and the program counter are fixed offsets from it
+// r12 holds how many instructions are left to run, every block takes its length off before it starts and goes back to
+// the dispatcher instead when there are fewer than that left
+// both are callee saved in the System V and the Windows calling conventions, so they survive the calls into the C handlers
+#define OFFSET_V offsetof(struct chip8, reg.V)
+#define OFFSET_I offsetof(struct chip8, reg.I)
+#define OFFSET_PC offsetof(struct chip8, reg.program_counter)
+
+// biggest block of code a single chip8 block can turn into, 32 helper calls at 28 bytes each plus the checks and jumps around them
+#define JIT_MAX_BLOCK_BYTES 1024
+
+typedef long (*jit_enter)(struct chip8* chip8, unsigned char* code, long budget);
+
+static void emit8(struct jit* jit, unsigned char value){
+    jit->code[jit->code_used++] = value;
+}
+static void emit16(struct jit* jit, unsigned short value){
+    memcpy(&jit->code[jit->code_used], &value, 2);
+    jit->code_used += 2;
+}
+static void emit32(struct jit* jit, uint32_t value){
+    memcpy(&jit->code[jit->code_used], &value, 4);
+    jit->code_used += 4;
+}
+static void emit64(struct jit* jit, uint64_t value){
+    memcpy(&jit->code[jit->code_used], &value, 8);
+    jit->code_used += 8;
+}
+// opcode and ModRM byte for [rbx + disp32], reg is the register or the /digit of the instruction
+static void emit_rbx_operand(struct jit* jit, unsigned char reg, uint32_t disp){
+    emit8(jit, 0x80 | (reg << 3) | 0x03);
+    emit32(jit, disp);
+}
+static void patch_rel32(struct jit* jit, unsigned int offset, unsigned int target){
+    uint32_t rel = target - (offset + 4);
+    memcpy(&jit->code[offset], &rel, 4);
+}
+
+// the entry and exit stubs live at the start of the buffer and survive a flush
+static void emit_stubs(struct jit* jit){
+    // push rbx; push rbp; push r12
+    emit8(jit, 0x53);
+    emit8(jit, 0x55);
+    emit8(jit, 0x41); emit8(jit, 0x54);
+#ifdef _WIN32
+    // sub rsp, 32 for the shadow space the callee may use; mov rbx, rcx; mov r12, r8; jmp rdx
+    emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xec); emit8(jit, 0x20);
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xcb);
+    emit8(jit, 0x4d); emit8(jit, 0x89); emit8(jit, 0xc4);
+    emit8(jit, 0xff); emit8(jit, 0xe2);
+#else
+    // mov rbx, rdi; mov r12, rdx; jmp rsi
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xfb);
+    emit8(jit, 0x49); emit8(jit, 0x89); emit8(jit, 0xd4);
+    emit8(jit, 0xff); emit8(jit, 0xe6);
+#endif
+    jit->exit_offset = jit->code_used;
+#ifdef _WIN32
+    // add rsp, 32
+    emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xc4); emit8(jit, 0x20);
+#endif
+    // mov rax, r12; pop r12; pop rbp; pop rbx; ret
+    emit8(jit, 0x4c); emit8(jit, 0x89); emit8(jit, 0xe0);
+    emit8(jit, 0x41); emit8(jit, 0x5c);
+    emit8(jit, 0x5d);
+    emit8(jit, 0x5b);
+    emit8(jit, 0xc3);
+    jit->stubs_size = jit->code_used;
+}
+
+// mov word [rbx + program_counter], value
+static void emit_set_pc(struct jit* jit, unsigned short value){
+    emit8(jit, 0x66); emit8(jit, 0xc7);
+    emit_rbx_operand(jit, 0, OFFSET_PC);
+    emit16(jit, value);
+}
+
+// calls the handler of ins with a copy of the instruction owned by the jit
+static void emit_call_handler(struct jit* jit, const struct instruction* ins){
+    struct instruction* copy = &jit->ops[jit->ops_used++];
+    *copy = *ins;
+#ifdef _WIN32
+    // mov rcx, rbx; mov rdx, copy
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xd9);
+    emit8(jit, 0x48); emit8(jit, 0xba);
+#else
+    // mov rdi, rbx; mov rsi, copy
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xdf);
+    emit8(jit, 0x48); emit8(jit, 0xbe);
+#endif
+    emit64(jit, (uint64_t)(uintptr_t)copy);
+    // mov rax, handler; call rax
+    emit8(jit, 0x48); emit8(jit, 0xb8);
+    emit64(jit, (uint64_t)(uintptr_t)instruction_handlers[ins->handler]);
+    emit8(jit, 0xff); emit8(jit, 0xd0);
+}
+
+// jmp to the block at target if it is translated, otherwise out to the dispatcher until it is
+// the program counter must already hold target
+static void emit_link(struct jit* jit, unsigned short target){
+    emit8(jit, 0xe9);
+    unsigned int offset = jit->code_used;
+    emit32(jit, 0);
+    if(target < 4096 && jit->entry[target]){
+        patch_rel32(jit, offset, jit->entry[target] - jit->code);
+        return;
+    }
+    patch_rel32(jit, offset, jit->exit_offset);
+    if(target < 4096 && jit->patch_count < JIT_MAX_PATCHES){
+        jit->patches[jit->patch_count].offset = offset;
+        jit->patches[jit->patch_count].target = target;
+        jit->patch_count += 1;
+    }
+}
+
+// jmp out to the dispatcher, used when the next address is only known at run time or memory may have been written
+static void emit_exit(struct jit* jit){
+    emit8(jit, 0xe9);
+    unsigned int offset = jit->code_used;
+    emit32(jit, 0);
+    patch_rel32(jit, offset, jit->exit_offset);
+}
+
+// the instructions that only touch V0-VF and I and have no flags to work out are written straight into the block,
+// returns false for everything else so it goes through the C handler
+static bool emit_inline(struct jit* jit, unsigned short opcode, const struct instruction* ins){
+    switch(opcode & 0xf000){
+        // 6xkk - mov byte [V + x], kk
+        case 0x6000:
+            emit8(jit, 0xc6);
+            emit_rbx_operand(jit, 0, OFFSET_V + ins->x);
+            emit8(jit, ins->kk);
+            return true;
+        // 7xkk - add byte [V + x], kk
+        case 0x7000:
+            emit8(jit, 0x80);
+            emit_rbx_operand(jit, 0, OFFSET_V + ins->x);
+            emit8(jit, ins->kk);
+            return true;
+        // Annn - mov word [I], nnn
+        case 0xA000:
+            emit8(jit, 0x66); emit8(jit, 0xc7);
+            emit_rbx_operand(jit, 0, OFFSET_I);
+            emit16(jit, ins->nnn);
+            return true;
+        case 0x8000:
+        {
+            // 8xy0 - mov, 8xy1 - or, 8xy2 - and, 8xy3 - xor [V + x], al
+            static const unsigned char alu[4] = {0x88, 0x08, 0x20, 0x30};
+            if(ins->n > 3){
+                return false;
+            }
+            // mov al, [V + y]
+            emit8(jit, 0x8a);
+            emit_rbx_operand(jit, 0, OFFSET_V + ins->y);
+            emit8(jit, alu[ins->n]);
+            emit_rbx_operand(jit, 0, OFFSET_V + ins->x);
+            return true;
+        }
+        case 0xF000:
+            if(ins->kk != 0x1E && ins->kk != 0x29){
+                return false;
+            }
+            // movzx eax, byte [V + x]
+            emit8(jit, 0x0f); emit8(jit, 0xb6);
+            emit_rbx_operand(jit, 0, OFFSET_V + ins->x);
+            if(ins->kk == 0x1E){
+                // Fx1E - add word [I], ax
+                emit8(jit, 0x66); emit8(jit, 0x01);
+                emit_rbx_operand(jit, 0, OFFSET_I);
+            }
+            else{
+                // Fx29 - lea eax, [rax + rax * 4]; mov word [I], ax
+                emit8(jit, 0x8d); emit8(jit, 0x04); emit8(jit, 0x80);
+                emit8(jit, 0x66); emit8(jit, 0x89);
+                emit_rbx_operand(jit, 0, OFFSET_I);
+            }
+            return true;
+    }
+    return false;
+}
+
+static bool is_skip(unsigned short opcode){
+    switch(opcode & 0xf000){
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xE000:
+            return true;
+    }
+    return false;
+}
+
+// the code that runs after the last instruction of a block, which is where the block links to the next one
+static void emit_block_end(struct jit* jit, unsigned short opcode, const struct instruction* ins, unsigned short address){
+    unsigned short next = address + 2;
+    if(!ends_block(opcode)){
+        // the block hit BLOCK_MAX_LENGTH, carry on with the next address
+        if(!emit_inline(jit, opcode, ins)){
+            emit_call_handler(jit, ins);
+        }
+        emit_set_pc(jit, next);
+        emit_link(jit, next);
+        return;
+    }
+    // 1nnn - no need to call anything, the target is known now
+    if((opcode & 0xf000) == 0x1000){
+        emit_set_pc(jit, ins->nnn);
+        emit_link(jit, ins->nnn);
+        return;
+    }
+    // every other handler expects the program counter to already point past the instruction
+    emit_set_pc(jit, next);
+    emit_call_handler(jit, ins);
+    if((opcode & 0xf000) == 0x2000){
+        emit_link(jit, ins->nnn);
+    }
+    else if(is_skip(opcode)){
+        // cmp word [program_counter], next; je not_skipped
+        emit8(jit, 0x66); emit8(jit, 0x81);
+        emit_rbx_operand(jit, 7, OFFSET_PC);
+        emit16(jit, next);
+        emit8(jit, 0x0f); emit8(jit, 0x84);
+        unsigned int offset = jit->code_used;
+        emit32(jit, 0);
+        emit_link(jit, next + 2);
+        patch_rel32(jit, offset, jit->code_used);
+        emit_link(jit, next);
+    }
+    else{
+        // 00EE and Bnnn go somewhere only known at run time, Fx33 and Fx55 may have written over translated code
+        // and Fx0A moves the program counter back to itself when it starts waiting for a key
+        emit_exit(jit);
+    }
+}
+
+// writes the perf map line for a new block
+static void perf_map_add(struct jit* jit, unsigned char* code, unsigned int size, unsigned short start){
+    if(!jit->perf_map){
+        return;
+    }
+    fprintf(jit->perf_map, "%llx %x chip8_block_%03x\n", (unsigned long long)(uintptr_t)code, size, start);
+    fflush(jit->perf_map);
+}
+
+// translates the block starting at start, returns 0 if there was not enough room left
+static unsigned char* translate(struct jit* jit, unsigned short start){
+    if(jit->code_used + JIT_MAX_BLOCK_BYTES > JIT_CODE_SIZE || jit->ops_used + BLOCK_MAX_LENGTH > JIT_MAX_OPS){
+        jit_flush(jit);
+    }
+    struct memory* mem = &jit->chip8->mem;
+    unsigned char* code = jit->code + jit->code_used;
+    // known before the block is written out so a block that jumps back to its own start links to itself
+    jit->entry[start] = code;
+
+    // cmp r12, length; jl exit; sub r12, length
+    emit8(jit, 0x49); emit8(jit, 0x81); emit8(jit, 0xfc);
+    unsigned int compare_offset = jit->code_used;
+    emit32(jit, 0);
+    emit8(jit, 0x0f); emit8(jit, 0x8c);
+    unsigned int offset = jit->code_used;
+    emit32(jit, 0);
+    patch_rel32(jit, offset, jit->exit_offset);
+    emit8(jit, 0x49); emit8(jit, 0x81); emit8(jit, 0xec);
+    unsigned int length_offset = jit->code_used;
+    emit32(jit, 0);
+
+    int length = 0;
+    int address = start;
+    while(true){
+        // straight from the dispatch table, the decoded cache may hold fused instructions that run more than one
+        unsigned short opcode = memory_get_short(mem, address);
+        const struct instruction* ins = decode(opcode);
+        length += 1;
+        if(ends_block(opcode) || length == BLOCK_MAX_LENGTH || address + 3 >= 4096){
+            emit_block_end(jit, opcode, ins, address);
+            break;
+        }
+        // nothing in the middle of a block reads the program counter, so it is left alone until the end
+        if(!emit_inline(jit, opcode, ins)){
+            emit_call_handler(jit, ins);
+        }
+        address += 2;
+    }
+    uint32_t length32 = length;
+    memcpy(&jit->code[compare_offset], &length32, 4);
+    memcpy(&jit->code[length_offset], &length32, 4);
+
+    // the block came from these pages, a write to them means the code has to be translated again
+    for(int page = start / MEMORY_PAGE_SIZE; page <= (address + 1) / MEMORY_PAGE_SIZE; page++){
+        jit->page_has_code[page] = true;
+        jit->page_version[page] = mem->page_version[page];
+    }
+    for(int i = start; i <= address + 1; i++){
+        jit->is_code[i] = true;
+        jit->code_bytes[i] = mem->memory_array[i];
+    }
+    // blocks that were waiting on this one can jump straight to it now
+    for(int i = 0; i < jit->patch_count; i++){
+        if(jit->patches[i].target == start){
+            patch_rel32(jit, jit->patches[i].offset, code - jit->code);
+            jit->patches[i] = jit->patches[--jit->patch_count];
+            i -= 1;
+        }
+    }
+    perf_map_add(jit, code, jit->code + jit->code_used - code, start);
+    return code;
+}
+
+// translated blocks link to each other without going through here, that is only safe because every instruction that writes to
+// memory ends its block with a jump back to the dispatcher, so this is the one place that has to look for written over code
+static void check_writes(struct jit* jit){
+    struct memory* mem = &jit->chip8->mem;
+    for(int page = 0; page < MEMORY_PAGES; page++){
+        if(!jit->page_has_code[page] || jit->page_version[page] == mem->page_version[page]){
+            continue;
+        }
+        // the page was written to, but it only matters if one of the bytes code was built from is different now
+        for(int i = page * MEMORY_PAGE_SIZE; i < (page + 1) * MEMORY_PAGE_SIZE; i++){
+            if(jit->is_code[i] && jit->code_bytes[i] != mem->memory_array[i]){
+                jit_flush(jit);
+                return;
+            }
+        }
+        jit->page_version[page] = mem->page_version[page];
+    }
+}
+
+struct jit* jit_create(struct chip8* chip8){
+    struct jit* jit = calloc(1, sizeof(struct jit));
+    if(!jit){
+        return 0;
+    }
+#ifdef _WIN32
+    jit->code = VirtualAlloc(0, JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    jit->code = mmap(0, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(jit->code == MAP_FAILED){
+        jit->code = 0;
+    }
+#endif
+    if(!jit->code){
+        free(jit);
+        return 0;
+    }
+    jit->chip8 = chip8;
+    emit_stubs(jit);
+#ifdef __linux__
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    jit->perf_map = fopen(path, "w");
+#endif
+    jit_flush(jit);
+    return jit;
+}
+
+void jit_destroy(struct jit* jit){
+    if(!jit){
+        return;
+    }
+    if(jit->perf_map){
+        fclose(jit->perf_map);
+    }
+#ifdef _WIN32
+    VirtualFree(jit->code, 0, MEM_RELEASE);
+#else
+    munmap(jit->code, JIT_CODE_SIZE);
+#endif
+    free(jit);
+}
+
+void jit_flush(struct jit* jit){
+    // keep the entry and exit stubs at the start of the buffer
+    jit->code_used = jit->stubs_size;
+    memset(jit->entry, 0, sizeof(jit->entry));
+    memset(jit->page_has_code, 0, sizeof(jit->page_has_code));
+    memset(jit->is_code, 0, sizeof(jit->is_code));
+    jit->ops_used = 0;
+    jit->patch_count = 0;
+}
+
+long jit_run(struct jit* jit, long count){
+    struct chip8* chip8 = jit->chip8;
+    jit_enter enter = (jit_enter)(void*)jit->code;
+    long budget = count;
+    while(budget > 0 && !keyboard_waiting(&chip8->keyboard)){
+        check_writes(jit);
+        unsigned short pc = chip8->reg.program_counter;
+        // blocks right at the end of memory are left to the interpreter
+        if(pc + 3 >= 4096){
+            step(chip8);
+            budget -= 1;
+            continue;
+        }
+        unsigned char* code = jit->entry[pc];
+        if(!code){
+            code = translate(jit, pc);
+        }
+        long left = enter(chip8, code, budget);
+        if(left < budget){
+            budget = left;
+            continue;
+        }
+        // every block that runs takes something off, so nothing ran: the block at the program counter is longer than
+        // what is left. the rest goes through the interpreter so the count comes out exact
+        while(budget > 0 && !keyboard_waiting(&chip8->keyboard)){
+            step_single(chip8);
+            budget -= 1;
+        }
+    }
+    return count - budget;
+}
+
+#else
+
+// not an x86-64 host, there is nothing to translate to
+struct jit* jit_create(struct chip8* chip8){
+    return 0;
+}
+void jit_destroy(struct jit* jit){
+}
+long jit_run(struct jit* jit, long count){
+    return 0;
+}
+void jit_flush(struct jit* jit){
+}
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "instruction.h"
+#include "memory.h"
+
+// size of the buffer the translated x86-64 code goes into, everything is thrown away and retranslated when it fills up
+#define JIT_CODE_SIZE (1024 * 1024)
+// copies of the instructions that translated code hands to the C handlers
+#define JIT_MAX_OPS 16384
+// jumps to blocks that were not translated yet, they are pointed at the block once it is
+#define JIT_MAX_PATCHES 4096
+
+struct chip8;
+
+// a jump at the end of a block that goes back to the dispatcher until the block at target gets translated
+struct jit_patch{
+    // offset of the rel32 of the jump in the code buffer
+    unsigned int offset;
+    unsigned short target;
+};
+
+// translates blocks of chip8 code (see block.c for how they are split) into x86-64 code and runs them
+// one jit belongs to one chip8 and the chip8 must stay at the same address for as long as the jit is used
+struct jit{
+    struct chip8* chip8;
+    unsigned char* code;
+    unsigned int code_used;
+    // where the block code jumps to, to leave and go back to jit_run()
+    unsigned int exit_offset;
+    // the entry and exit stubs take up the start of the buffer, blocks go after them
+    unsigned int stubs_size;
+    // translated code for the block starting at each address, 0 if there is none
+    unsigned char* entry[4096];
+    struct instruction ops[JIT_MAX_OPS];
+    int ops_used;
+    struct jit_patch patches[JIT_MAX_PATCHES];
+    int patch_count;
+    // pages that translated code was built from, with their version at the time
+    bool page_has_code[MEMORY_PAGES + 1];
+    unsigned int page_version[MEMORY_PAGES + 1];
+    // the bytes translated code was built from, so a write to data that shares a page with code does not throw the code away
+    bool is_code[4096];
+    unsigned char code_bytes[4096];
+    // /tmp/perf-PID.map so perf can put names on the translated code, 0 if it could not be opened
+    FILE* perf_map;
+};
+
+// returns 0 when the host is not x86-64 or executable memory could not be allocated, callers then stay on the interpreter
+struct jit* jit_create(struct chip8* chip8);
+void jit_destroy(struct jit* jit);
+// runs at least count instructions, anything that cannot be translated is run through step(), returns how many were run
+long jit_run(struct jit* jit, long count);
+// throws away all translated code
+void jit_flush(struct jit* jit);
+
+#endif
@@ -6,7 +6,7 @@ void key_out_of_bound(int key){
 }
 // map is an array of virtual keys that will be used by chip8, key is the actual key we press down on the physical keyboard
 int key_map(struct keyboard* board, char key){
-    for(int i = 0; i < 16; i++){
+    for(int i = 0; i < KEY_NUM; i++){
         if(board->virtual_keys[i] == key){
             return i;
         }
@@ -19,10 +19,26 @@ void keyboard_set_map(struct keyboard* board, const char* map){
 
 void key_down(struct keyboard* board, int key){
     board->key_array[key] = true;
+    if(keyboard_waiting(board)){
+        if(board->wait_for_release){
+            board->wait_pressed |= 1 << key;
+        }
+        else{
+            board->wait_key = key;
+        }
+    }
 }
 void key_up(struct keyboard* board, int key){
     board->key_array[key] = false;
+    if(keyboard_waiting(board) && board->wait_for_release && (board->wait_pressed & 1 << key)){
+        board->wait_key = key;
+    }
 }
 bool is_key_down(struct keyboard* board, int key){
     return board->key_array[key];
+}
+void keyboard_start_wait(struct keyboard* board){
+    board->waiting = true;
+    board->wait_key = -1;
+    board->wait_pressed = 0;
 }
\ No newline at end of file
@@ -3,9 +3,18 @@
 
 // section 2.3 chip8 reference 
 #include <stdbool.h>
+#define KEY_NUM 16
 struct keyboard{
-    bool key_array[16];
-    char* virtual_keys;
+    bool key_array[KEY_NUM];
+    const char* virtual_keys;
+    // Fx0A, set from the time it starts waiting until it takes the key that ended the wait (see wait_for_key_press())
+    bool waiting;
+    // the key that ended the wait, -1 while there is none yet
+    int wait_key;
+    // keys that went down during the wait, for wait_for_release
+    unsigned short wait_pressed;
+    // quirk, the COSMAC VIP only finished Fx0A once the key was let go again. otherwise the next key to go down ends it
+    bool wait_for_release;
 };
 
 void keyboard_set_map(struct keyboard* board, const char* map);
@@ -15,5 +24,12 @@ int key_map(struct keyboard* board, char key);
 void key_down(struct keyboard* board, int key);
 void key_up(struct keyboard* board, int key);
 bool is_key_down(struct keyboard* board, int key);
+// Fx0A, keys that are already down when this is called don't end the wait
+void keyboard_start_wait(struct keyboard* board);
+
+// true while Fx0A is waiting and no key has ended the wait yet, the cores run nothing until it is false again
+static inline bool keyboard_waiting(const struct keyboard* board){
+    return board->waiting && board->wait_key < 0;
+}
 
 #endif
\ No newline at end of file
@@ -0,0 +1,382 @@
+// bin/lockstep runs every core against exec_switch() side by side and reports where they stop agreeing
+//   lockstep <instructions> [rom file]...
+//
+// the core runs a random number of instructions, exec_switch() runs as many after it, and then the registers, memory,
+// stack, screen and keyboard wait of the two have to be the same. besides the roms it runs programs that write over
+// their own code, which the cores that keep decoded, block or translated code around have to notice (see
+// page_version in memory.h), and random programs that do the same kind of writes all over themselves.
+// a build with CHIP8_AOT (make lockstep always has it) also checks the roms in AOT_ROMS on the code bin/aot compiled
+// them to, in the aot column. it is - for the programs that weren't compiled.
+// it returns how many runs disagreed, so 0 is a pass
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "chip8.h"
+#include "cores.h"
+#include "scheduler.h"
+#include "aot.h"
+
+#define RANDOM_PROGRAMS 200
+#define RANDOM_LENGTH 200
+#define RANDOM_INSTRUCTIONS 20000
+
+// a rom that waits for a key gets 0 pressed for it, the same on both sides
+static const char keys[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+struct program{
+    const char* name;
+    // the rom is loaded at 0x200 and load() wants it to end before the last byte of memory
+    char code[4096 - 0x200 - 1];
+    size_t size;
+};
+
+// writes the instructions of a built in program into it, address is where the first one goes
+static void assemble(struct program* program, int address, const unsigned short* code, int count){
+    for(int i = 0; i < count; i++){
+        int offset = address - 0x200 + 2 * i;
+        program->code[offset] = code[i] >> 8;
+        program->code[offset + 1] = code[i] & 0xff;
+        if((size_t)offset + 2 > program->size){
+            program->size = offset + 2;
+        }
+    }
+}
+
+// a loop that writes the kk of an instruction a little further on every time around, the block and the translated
+// code from the last time around have the old kk in them
+static const unsigned short patch_ahead[] = {
+    0x6A00, // 200: VA = 0
+    0x6011, // 202: V0 = 0x11
+    0x80A4, // 204: V0 += VA
+    0xA20F, // 206: I = 0x20F, the kk of 6Bkk at 0x20E
+    0xF055, // 208: [I] = V0
+    0x7A01, // 20A: VA += 1
+    0x6C00, // 20C: VC = 0
+    0x6B00, // 20E: VB = kk, whatever the F055 wrote
+    0x1202, // 210: back to 0x202
+};
+
+// a subroutine on another page than the code that calls it, rewritten through Fx33 and the Fx55 quirk (every byte gets
+// Vx) between calls. the F055 to 0x330 is a write to data on the subroutine's page that leaves its code as it was
+static const unsigned short call_patch[] = {
+    0x6000, // 200: V0 = 0
+    0x626B, // 202: V2 = 0x6B
+    0x2300, // 204: call 0x300
+    0x7017, // 206: V0 += 0x17
+    0xA301, // 208: I = 0x301
+    0xF033, // 20A: hundreds, tens and ones of V0 over 0x301 to 0x303, 0x302 turns into a 0nnn that does nothing
+    0x2300, // 20C: call 0x300
+    0xA330, // 20E: I = 0x330, data on the page of the subroutine
+    0xF055, // 210: [I] = V0
+    0x2300, // 212: call 0x300
+    0xA300, // 214: I = 0x300
+    0xF255, // 216: V2 over 0x300 to 0x302
+    0x2300, // 218: call 0x300
+    0x1204, // 21A: back to 0x204
+};
+static const unsigned short call_patch_subroutine[] = {
+    0x6B00, // 300: VB = kk
+    0x6C00, // 302: VC = kk
+    0x8BC4, // 304: VB += VC
+    0x00EE, // 306: return
+};
+
+// a block that starts on one page and goes on into the next, only the part on the second page is written to. the
+// 6E00; 6B00 at 0x240 is fused (see fusion.c), so the write to its second instruction has to throw away the pair
+static const unsigned short page_edge_start[] = {
+    0x6A00, // 200: VA = 0
+    0x1238, // 202: jump 0x238
+};
+static const unsigned short page_edge[] = {
+    0x7A01, // 238: VA += 1
+    0x80A0, // 23A: V0 = VA
+    0x6C00, // 23C: VC = 0
+    0x6D00, // 23E: VD = 0
+    0x6E00, // 240: VE = 0, the next page starts here
+    0x6B00, // 242: VB = kk, whatever the F055 wrote
+    0xA243, // 244: I = 0x243
+    0xF055, // 246: [I] = V0
+    0x1238, // 248: back to 0x238
+};
+
+// jumps to the last two addresses of memory, where there is room for one instruction and then for only half of one.
+// load() can't put anything there so the program writes them itself: 0x12 into both makes 0xFFE a 1212 and 0xFFF,
+// whose second byte is read from 0x000 (the F0 of the font), a 12F0
+static const unsigned short memory_end[] = {
+    0x6012, // 200: V0 = 0x12
+    0x6112, // 202: V1 = 0x12
+    0xAFFE, // 204: I = 0xFFE
+    0xF155, // 206: [I] = V0, V1
+    0x6A00, // 208: VA = 0
+    0x7A01, // 20A: VA += 1
+    0x1FFE, // 20C: jump 0xFFE, which jumps to 0x212
+    0x0000, // 20E: never run
+    0x0000, // 210: never run
+    0x7B01, // 212: VB += 1
+    0x1FFF, // 214: jump 0xFFF, which jumps to 0x2F0
+};
+static const unsigned short memory_end_back[] = {
+    0x120A, // 2F0: back to 0x20A
+};
+
+static uint32_t next_random(uint32_t* state){
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// a random program of RANDOM_LENGTH instructions that ends in two jumps back to the start, so a skip can't take it
+// past the end. next to plain instructions it has Annn; F055 and Annn; Fx33 pairs that write over the kk of a 6xkk or
+// 7xkk somewhere in it, Fx33 also turns the instruction after the kk into a 0nnn that does nothing. I only ever points
+// at the font or at a kk whose instruction isn't followed by another 6xkk or 7xkk, so nothing that gets written can
+// turn into an instruction the program wasn't built with
+static bool is_target(const unsigned short* code, int i){
+    return (code[i] & 0xe000) == 0x6000 && (code[i + 1] & 0xe000) != 0x6000 && i + 1 < RANDOM_LENGTH - 2;
+}
+
+static void random_program(struct program* program, uint32_t* state){
+    unsigned short code[RANDOM_LENGTH];
+    for(int i = 0; i < RANDOM_LENGTH; i++){
+        int x = next_random(state) % 16;
+        int y = next_random(state) % 16;
+        int kk = next_random(state) & 0xff;
+        switch(next_random(state) % 16){
+            case 0: code[i] = 0x6000 | x << 8 | kk; break;
+            case 1: code[i] = 0x7000 | x << 8 | kk; break;
+            case 2: code[i] = 0x8000 | x << 8 | y << 4 | (next_random(state) % 8); break;
+            case 3: code[i] = 0x800E | x << 8 | y << 4; break;
+            case 4: code[i] = (next_random(state) % 2 ? 0x3000 : 0x4000) | x << 8 | kk; break;
+            case 5: code[i] = (next_random(state) % 2 ? 0x5000 : 0x9000) | x << 8 | y << 4; break;
+            // a sprite out of the font
+            case 6: code[i] = 0xA000 | (next_random(state) % 0x50); break;
+            case 7: code[i] = 0xD000 | x << 8 | y << 4 | (next_random(state) % 16); break;
+            case 8: code[i] = 0xC000 | x << 8 | kk; break;
+            case 9: code[i] = next_random(state) % 2 ? 0xF007 | x << 8 : 0xF015 | x << 8; break;
+            case 10: code[i] = next_random(state) % 2 ? 0xF065 | (x % 4) << 8 : 0xF018 | x << 8; break;
+            case 11: code[i] = 0x00C0 | (next_random(state) % 16); break;
+            // 00FB to 00FF without 00FD, the EXIT the cores don't have
+            case 12: code[i] = 0x00FB + next_random(state) % 4; code[i] += code[i] == 0x00FD; break;
+            case 13: code[i] = next_random(state) % 2 ? 0x00E0 : 0xF03A | x << 8; break;
+            // a write pair, its Annn gets pointed at a kk below once the whole program is there
+            default:
+                code[i] = 0xA000;
+                if(i + 1 < RANDOM_LENGTH){
+                    code[++i] = next_random(state) % 2 ? 0xF055 : 0xF033 | x << 8;
+                }
+        }
+    }
+    code[RANDOM_LENGTH - 2] = 0x1200;
+    code[RANDOM_LENGTH - 1] = 0x1200;
+    int targets[RANDOM_LENGTH];
+    int target_count = 0;
+    for(int i = 0; i < RANDOM_LENGTH - 2; i++){
+        if(is_target(code, i)){
+            targets[target_count++] = 0x200 + 2 * i + 1;
+        }
+    }
+    for(int i = 0; i < RANDOM_LENGTH - 2; i++){
+        if(code[i] == 0xA000 && target_count > 0){
+            code[i] |= targets[next_random(state) % target_count];
+        }
+    }
+    program->size = 0;
+    assemble(program, 0x200, code, RANDOM_LENGTH);
+}
+
+static struct chip8 reference;
+static struct chip8 tested;
+static struct scheduler scheduler;
+
+static void start(const struct core* core, struct chip8* chip8, const struct program* program){
+    init(chip8);
+    load(chip8, program->code, program->size);
+    keyboard_set_map(&chip8->keyboard, keys);
+    core_start(core, chip8);
+}
+
+static void reference_run(long count){
+    unsigned char* memory = reference.mem.memory_array;
+    for(long i = 0; i < count; i++){
+        // the second byte of an instruction at 0xFFF comes from 0x000, the same as in memory_get_instruction()
+        unsigned short pc = reference.reg.program_counter;
+        assert(pc < 4096);
+        unsigned short opcode = memory[pc] << 8 | memory[(pc + 1) & 0x0fff];
+        reference.reg.program_counter += 2;
+        exec_switch(&reference, opcode);
+    }
+}
+
+static bool same(void){
+    return memcmp(reference.mem.memory_array, tested.mem.memory_array, sizeof(reference.mem.memory_array)) == 0
+        && memcmp(&reference.reg, &tested.reg, sizeof(reference.reg)) == 0
+        && memcmp(&reference.stack, &tested.stack, sizeof(reference.stack)) == 0
+        && memcmp(&reference.screen, &tested.screen, sizeof(reference.screen)) == 0
+        && keyboard_waiting(&reference.keyboard) == keyboard_waiting(&tested.keyboard)
+        && reference.random == tested.random;
+}
+
+// runs program on core and on exec_switch() for instructions, returns how many had gone by when the two stopped being
+// the same or -1 if they never did
+static long check(const struct core* core, const struct program* program, long instructions, uint32_t* state){
+    start(&cores[0], &reference, program);
+    start(core, &tested, program);
+    scheduler_init(&scheduler, SCHEDULER_DEFAULT_RATE);
+    long done = 0;
+    while(done < instructions){
+        // a rom that calls deeper every time 0 is pressed starts over before push() asserts, the same as in bin/bench
+        if(reference.reg.stack_pointer == 16){
+            start(&cores[0], &reference, program);
+            start(core, &tested, program);
+        }
+        if(keyboard_waiting(&tested.keyboard)){
+            key_down(&tested.keyboard, 0);
+            key_up(&tested.keyboard, 0);
+            key_down(&reference.keyboard, 0);
+            key_up(&reference.keyboard, 0);
+        }
+        while(scheduler_due(&scheduler) > 0 && !keyboard_waiting(&tested.keyboard)){
+            long asked = 1 + next_random(state) % scheduler_due(&scheduler);
+            long ran = core->run(&tested, asked);
+            reference_run(ran);
+            scheduler_advance(&scheduler, ran);
+            done += ran;
+            // running past what it was asked for moves the tick boundary even when the state agrees
+            if(ran > asked || !same()){
+                return done;
+            }
+        }
+        scheduler_tick(&scheduler, &tested);
+        timers_tick(&reference.reg);
+    }
+    return -1;
+}
+
+static void print_result(long diverged){
+    if(diverged < 0){
+        printf("%12s", "ok");
+    }
+    else{
+        printf("%12ld", diverged);
+    }
+}
+
+static struct program program;
+
+// the compiled code for program as a core of its own, 0 if it wasn't compiled
+static const struct core* compiled_core(void){
+#ifdef CHIP8_AOT
+    static struct core compiled;
+    const struct aot_rom* rom = aot_find(program.code, program.size);
+    if(rom){
+        compiled = (struct core){rom->name, rom->run, 0};
+        return &compiled;
+    }
+#endif
+    return 0;
+}
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        printf("usage: lockstep <instructions> [rom file]...\n");
+        return -1;
+    }
+    long instructions = atol(argv[1]);
+    uint32_t state = CHIP8_DEFAULT_SEED;
+    int failed = 0;
+    printf("the instruction each core stopped agreeing with switch at\n%-16s", "program");
+    for(int c = 1; c < core_count; c++){
+        printf("%12s", cores[c].name);
+    }
+#ifdef CHIP8_AOT
+    printf("%12s", "aot");
+#endif
+    printf("\n");
+
+    for(int p = 0; p < 4 + argc - 2; p++){
+        memset(&program, 0, sizeof(program));
+        if(p == 0){
+            program.name = "patch ahead";
+            assemble(&program, 0x200, patch_ahead, sizeof(patch_ahead) / sizeof(patch_ahead[0]));
+        }
+        else if(p == 1){
+            program.name = "call patch";
+            assemble(&program, 0x200, call_patch, sizeof(call_patch) / sizeof(call_patch[0]));
+            assemble(&program, 0x300, call_patch_subroutine, sizeof(call_patch_subroutine) / sizeof(call_patch_subroutine[0]));
+        }
+        else if(p == 2){
+            program.name = "page edge";
+            assemble(&program, 0x200, page_edge_start, sizeof(page_edge_start) / sizeof(page_edge_start[0]));
+            assemble(&program, 0x238, page_edge, sizeof(page_edge) / sizeof(page_edge[0]));
+        }
+        else if(p == 3){
+            program.name = "memory end";
+            assemble(&program, 0x200, memory_end, sizeof(memory_end) / sizeof(memory_end[0]));
+            assemble(&program, 0x2F0, memory_end_back, sizeof(memory_end_back) / sizeof(memory_end_back[0]));
+        }
+        else{
+            program.name = argv[p - 2];
+            FILE* f = fopen(program.name, "rb");
+            if(!f){
+                printf("failed to open %s\n", program.name);
+                failed += 1;
+                continue;
+            }
+            program.size = fread(program.code, 1, sizeof(program.code), f);
+            fclose(f);
+        }
+        printf("%-16s", program.name);
+        for(int c = 1; c < core_count; c++){
+            long diverged = check(&cores[c], &program, instructions, &state);
+            failed += diverged >= 0;
+            print_result(diverged);
+        }
+#ifdef CHIP8_AOT
+        const struct core* compiled = compiled_core();
+        if(compiled){
+            long diverged = check(compiled, &program, instructions, &state);
+            failed += diverged >= 0;
+            print_result(diverged);
+        }
+        else{
+            printf("%12s", "-");
+        }
+#endif
+        printf("\n");
+    }
+
+    // the random programs come out the same every time, the one that went wrong can be found again by its number
+    printf("%-16s", "random");
+    for(int c = 1; c < core_count; c++){
+        uint32_t program_state = CHIP8_DEFAULT_SEED;
+        int bad = 0;
+        for(int p = 0; p < RANDOM_PROGRAMS; p++){
+            memset(&program, 0, sizeof(program));
+            random_program(&program, &program_state);
+            long diverged = check(&cores[c], &program, RANDOM_INSTRUCTIONS, &state);
+            if(diverged >= 0){
+                if(bad == 0){
+                    fprintf(stderr, "%s: random program %d stopped agreeing at %ld\n", cores[c].name, p, diverged);
+                }
+                bad += 1;
+            }
+        }
+        failed += bad;
+        if(bad){
+            printf("%9d bad", bad);
+        }
+        else{
+            printf("%12s", "ok");
+        }
+    }
+#ifdef CHIP8_AOT
+    // none of the random programs are compiled
+    printf("%12s", "-");
+#endif
+    printf("\n");
+    return failed;
+}
@@ -1,14 +1,198 @@
 #include <stdio.h>
 #include <stdbool.h>
-#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "SDL2/SDL.h"
 #include "chip8.h"
 #include "keyboard.h"
+#include "threaded.h"
+#include "jit.h"
+#include "idle.h"
+#include "renderer.h"
+#include "pipeline.h"
+#include "recorder.h"
+#include "scheduler.h"
+#include "audio.h"
+#include "aot.h"
 
 // these are physical keyboard keys, their index is mapped to chip8 virtual keys e.g 0x00 at index 0 is mapped to 1 for chip8 key
 const char virtual_keys[16] = {SDLK_0, SDLK_1, SDLK_2, SDLK_3, SDLK_4, SDLK_5, SDLK_6, SDLK_7, SDLK_8, 
                                 SDLK_9, SDLK_a, SDLK_b, SDLK_c, SDLK_d, SDLK_e, SDLK_f};
 
+// everything the threads share. the emulation thread owns chip8 once it is started, the others only go through
+// the frame exchange, the key queue and the two flags
+struct shared{
+    struct chip8 chip8;
+    // instructions a second, see struct scheduler
+    long rate;
+    struct frame_exchange frames;
+    struct key_queue keys;
+    SDL_atomic_t quit;
+    struct audio audio;
+    // the rom compiled to C by bin/aot, only ever set when it was linked in with make AOT=1 and the rom is one of them
+    const struct aot_rom* aot;
+};
+static struct shared shared;
+// only used with --capture, too big for the stack
+static struct recorder recorder;
+
+// SDL_Delay() can oversleep by a millisecond or so, it only sleeps until shortly before deadline and the rest is
+// waited out on the performance counter
+static void sleep_until(uint64_t deadline, uint64_t frequency){
+    uint64_t margin = frequency / 500;
+    uint64_t now = SDL_GetPerformanceCounter();
+    if(now + margin < deadline){
+        SDL_Delay((Uint32)((deadline - now - margin) * 1000 / frequency));
+    }
+    while(SDL_GetPerformanceCounter() < deadline){
+        SDL_Delay(0);
+    }
+}
+
+// what the audio thread was last told about the sound
+struct sound_sent{
+    bool on;
+    unsigned char pattern_version;
+    unsigned char pitch;
+};
+
+// sends whatever changed since the last call, stamped with the emulated time it is at now. a change that doesn't fit
+// in the ring is sent again next time
+static void send_sound(struct audio* audio, struct sound_sent* sent, const struct registers* reg, uint64_t time){
+    if(reg->pattern_version != sent->pattern_version && audio_pattern(audio, time, reg->pattern)){
+        sent->pattern_version = reg->pattern_version;
+    }
+    if(reg->pitch != sent->pitch && audio_pitch(audio, time, reg->pitch)){
+        sent->pitch = reg->pitch;
+    }
+    if((sound_timer_get(reg) > 0) != sent->on && audio_gate(audio, time, !sent->on)){
+        sent->on = !sent->on;
+    }
+}
+
+#ifdef CHIP8_JIT
+// 0 when the host can't run translated code, chip8_run() does the work then
+static struct jit* jit;
+#endif
+
+// runs up to count instructions on the core picked with make CORE= (or the compiled rom, see make AOT=1), ran gets how
+// many were run. only chip8_run() stops where the sound changes, the others tell the sound about it at the tick
+static enum run_stop run_core(struct shared* shared, long count, long* ran){
+    struct chip8* chip8 = &shared->chip8;
+#ifdef CHIP8_AOT
+    if(shared->aot){
+        *ran = shared->aot->run(chip8, count);
+        return RUN_DONE;
+    }
+#endif
+#if defined(CHIP8_THREADED)
+    // the computed goto core
+    *ran = exec_threaded(chip8, count);
+    return RUN_DONE;
+#else
+#ifdef CHIP8_JIT
+    // the blocks at the program counter translated to x86-64
+    if(jit){
+        *ran = jit_run(jit, count);
+        return RUN_DONE;
+    }
+#endif
+    // runs until it has done count or one of the instructions needs something from this thread, the instructions are
+    // only decoded the first time we get to their address
+    return chip8_run(chip8, count, ran);
+#endif
+}
+
+// runs the program at a steady rate, nothing in here waits on the renderer or on the sound
+static int emulate(void* data){
+    struct shared* shared = data;
+    struct chip8* chip8 = &shared->chip8;
+    struct scheduler scheduler;
+    scheduler_init(&scheduler, shared->rate);
+    uint64_t frequency = SDL_GetPerformanceFrequency();
+    // the wall clock time tick base_tick was due at, each tick after it is due a 60th of a second later. it is worked
+    // out from the count every time so rounding doesn't pile up
+    uint64_t base_time = SDL_GetPerformanceCounter();
+    uint64_t base_tick = 0;
+    // hash of the last frame sent to the main thread, it starts out with the blank screen it already has
+    uint64_t published = 0;
+    struct sound_sent sound = {false, chip8->reg.pattern_version, chip8->reg.pitch};
+#ifdef CHIP8_JIT
+    jit = jit_create(chip8);
+#endif
+    while(!SDL_AtomicGet(&shared->quit)){
+        // a key going down (or up, see wait_for_release) is also what ends an Fx0A wait
+        struct key_event event;
+        while(key_queue_pop(&shared->keys, &event)){
+            if(event.down){
+                key_down(&chip8->keyboard, event.key);
+            }
+            else{
+                key_up(&chip8->keyboard, event.key);
+            }
+        }
+
+        // everything up to the instruction the timers tick on, in as few calls as the core can manage
+        while(scheduler_due(&scheduler) > 0 && !keyboard_waiting(&chip8->keyboard)){
+            // a program waiting on the delay timer or jumping to itself can't do anything until the timers tick,
+            // skip_idle() puts the registers where the loop would have them and the rest of this tick is skipped
+            if(skip_idle(chip8) != IDLE_NONE){
+                break;
+            }
+            long ran;
+            enum run_stop stop = run_core(shared, scheduler_due(&scheduler), &ran);
+            scheduler_advance(&scheduler, ran);
+            // Fx18, F002 and Fx3A change the sound at the instruction they are on, which is the last one that ran
+            if(stop == RUN_TIMER || stop == RUN_SOUND){
+                send_sound(&shared->audio, &sound, &chip8->reg, scheduler.cycle);
+            }
+        }
+        // an idle program or one waiting on Fx0A spends the rest of the tick doing nothing
+        scheduler_tick(&scheduler, chip8);
+        // the sound timer running out happens on the tick, and the cores that don't stop for the sound changing get to
+        // tell it here
+        send_sound(&shared->audio, &sound, &chip8->reg, scheduler.cycle);
+
+        // a new frame only goes out when something on the screen changed, and not when the program only erased and
+        // drew its sprites again in the same places, which leaves the frame that went out last
+        struct screen_dirty dirty;
+        if(screen_take_dirty(&chip8->screen, &dirty) && screen_hash(&chip8->screen) != published){
+            *frame_back(&shared->frames) = chip8->screen;
+            frame_publish(&shared->frames);
+            published = screen_hash(&chip8->screen);
+        }
+
+        // the thread sleeps for as long as emulated time is ahead of the wall clock. after falling far behind (the
+        // window being dragged, a debugger) it starts counting from now instead of running flat out to catch up
+        uint64_t due = base_time + (scheduler.ticks - base_tick) * frequency / SCHEDULER_TICKS_PER_SECOND;
+        uint64_t now = SDL_GetPerformanceCounter();
+        if(now < due){
+            sleep_until(due, frequency);
+        }
+        else if(now - due > frequency / 4){
+            base_time = now;
+            base_tick = scheduler.ticks;
+        }
+    }
+#ifdef CHIP8_JIT
+    jit_destroy(jit);
+#endif
+    return 0;
+}
+
+// the colours of a pixel that is off and on, CHIP8_PALETTE=RRGGBB,RRGGBB picks others
+static void read_palette(uint32_t palette[2]){
+    palette[0] = 0xFF000000;
+    palette[1] = 0xFFFFFFFF;
+    const char* wanted = getenv("CHIP8_PALETTE");
+    unsigned off, on;
+    if(wanted && sscanf(wanted, "%6x,%6x", &off, &on) == 2){
+        palette[0] = 0xFF000000 | off;
+        palette[1] = 0xFF000000 | on;
+    }
+}
+
 int main(int argc, char **argv){
 
     // argc = argument counter 
@@ -18,6 +202,28 @@ int main(int argc, char **argv){
         return -1;
     }
     const char* file_name = argv[1];
+    // main <rom file> [--ips n] [--capture <file>] [--wait-for-release]
+    // --ips is how many instructions run in a second, 600 if it is not given. --capture records everything that is
+    // shown, bin/capconv turns it into a video. --wait-for-release has Fx0A finish when the key is let go, the way
+    // the COSMAC VIP did
+    const char* capture_name = 0;
+    bool wait_for_release = false;
+    shared.rate = SCHEDULER_DEFAULT_RATE;
+    for(int i = 2; i < argc; i++){
+        if(strcmp(argv[i], "--capture") == 0 && i + 1 < argc){
+            capture_name = argv[++i];
+        }
+        else if(strcmp(argv[i], "--ips") == 0 && i + 1 < argc){
+            shared.rate = atol(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--wait-for-release") == 0){
+            wait_for_release = true;
+        }
+    }
+    if(shared.rate < 1){
+        printf("--ips has to be at least 1");
+        return -1;
+    }
     printf("file name is: %s\n", file_name);
     // open file and set mode to read binary
     FILE* f = fopen(file_name, "rb");
@@ -40,81 +246,100 @@ int main(int argc, char **argv){
         printf("failed to read from file");
         return -1;
     }
-    struct chip8 chip8;
-    init(&chip8);
-    load(&chip8, buffer, size);
-    keyboard_set_map(&chip8.keyboard, virtual_keys);
+    struct chip8* chip8 = &shared.chip8;
+    init(chip8);
+    // a game is meant to play out differently every time, headless is the one that wants the same run again
+    chip8_seed(chip8, time(0));
+    load(chip8, buffer, size);
+    keyboard_set_map(&chip8->keyboard, virtual_keys);
+    chip8->keyboard.wait_for_release = wait_for_release;
+#ifdef CHIP8_AOT
+    // make AOT=1 links in the roms in AOT_ROMS compiled to C, any other rom runs on the core as usual
+    shared.aot = aot_find(buffer, size);
+    if(shared.aot){
+        printf("running the compiled %s\n", shared.aot->name);
+    }
+#endif
+    frame_exchange_init(&shared.frames);
+    key_queue_init(&shared.keys);
 
     // initialize SDL
     SDL_Init(SDL_INIT_EVERYTHING);
     // creating the window
     SDL_Window* window = SDL_CreateWindow("CHIP-8 EMULATOR", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 640, 320, SDL_WINDOW_SHOWN);
 
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_TEXTUREACCESS_TARGET);
-    while(1){
+    uint32_t palette[2];
+    read_palette(palette);
+    struct renderer renderer;
+    if(!renderer_create(&renderer, window, palette)){
+        printf("failed to create the renderer: %s", SDL_GetError());
+        return -1;
+    }
+    // the emulator still runs without a sound device, it is only quiet
+    if(!audio_open(&shared.audio, shared.rate)){
+        printf("no sound: %s\n", SDL_GetError());
+    }
+    if(capture_name && !recorder_start(&recorder, capture_name)){
+        printf("failed to open %s", capture_name);
+        return -1;
+    }
+    // the main thread only handles input and drawing, SDL wants both of them on the thread that made the window
+    SDL_Thread* emulation = SDL_CreateThread(emulate, "emulation", &shared);
+    // the last frame that came from the emulation thread, the renderer works out what changed from it
+    struct screen screen;
+    memset(&screen, 0, sizeof(screen));
+    // the hash of the last frame recorded, a present that only redraws the window does not need recording again
+    uint64_t recorded = 0;
+    bool first_frame = true;
+    bool running = true;
+    while(running){
 
-        // handling quit event
+        // handling quit event, waiting a few ms for one so this thread sleeps between frames instead of spinning
         SDL_Event event;
-        while(SDL_PollEvent(&event)){
+        bool have_event = SDL_WaitEventTimeout(&event, 4);
+        while(have_event){
             if(event.type == SDL_QUIT){
-                SDL_DestroyWindow(window);
-                return 0;
+                running = false;
             }
-            else if(event.type == SDL_KEYDOWN){
-                // getting the key pressed
-                char key = event.key.keysym.sym;
-                int virtual_key = key_map(&chip8.keyboard, key);
-                if(virtual_key != -1){
-                    printf("%x\n", virtual_key);
-                    key_down(&chip8.keyboard, virtual_key);
-                }
+            // anything that uncovers the window has to be drawn again even if the screen did not change
+            else if(event.type == SDL_WINDOWEVENT){
+                renderer_invalidate(&renderer);
             }
-            else if(event.type == SDL_KEYUP){
+            else if(event.type == SDL_KEYDOWN || event.type == SDL_KEYUP){
+                // getting the key pressed, the emulation thread gets it through the queue
                 char key = event.key.keysym.sym;
-                int virtual_key = key_map(&chip8.keyboard, key);
-                if(virtual_key != -1){
-                    key_up(&chip8.keyboard, virtual_key);
-                    printf("%x\n", virtual_key);
-                }   
-            }
-        }
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-        SDL_RenderClear(renderer);
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        for(int x = 0; x < 64; x++){
-            for(int y = 0; y < 32; y++){
-                
-                if(is_screen_set(&chip8.screen, x, y)){
-                    SDL_Rect r;
-                    r.x = x * 10; // since we are scaling everything up by 10 times, so every 10 pixels are 1 pixel for the emulation
-                    r.y = y * 10;
-                    r.w = 10;
-                    r.h = 10;
-                    SDL_RenderFillRect(renderer, &r);
+                int virtual_key = key_map(&chip8->keyboard, key);
+                if(virtual_key != -1 && !event.key.repeat){
+                    struct key_event key_event = {virtual_key, event.type == SDL_KEYDOWN};
+                    key_queue_push(&shared.keys, key_event);
                 }
             }
-        }
-        SDL_RenderPresent(renderer);
-        
-        // delay timer, using sleep to simulate delaying by 60Hz
-        if(chip8.reg.delay_timer > 0){
-            Sleep(5);
-            chip8.reg.delay_timer -= 1;
+            have_event = SDL_PollEvent(&event);
         }
 
-        // simulating sound timer
-        if(chip8.reg.sound_timer > 0){
-            Beep(1500, 100);
-            chip8.reg.sound_timer -= 1;
+        const struct screen* frame = frame_take(&shared.frames);
+        if(frame){
+            screen_copy(&screen, frame);
         }
+        // shows the screen at most once per 60Hz frame and only if it changed
+        bool presented = renderer_present(&renderer, &screen);
+        if(capture_name && presented && (first_frame || screen_hash(&screen) != recorded)){
+            recorder_add(&recorder, &screen, SDL_GetTicks());
+            recorded = screen_hash(&screen);
+            first_frame = false;
+        }
+    }
 
-        // reading two bytes from where the program counter is pointing to, which is the intruction
-        unsigned short opcode = memory_get_short(&chip8.mem, chip8.reg.program_counter);
-        chip8.reg.program_counter += 2;
-        exec(&chip8, opcode);
-    }    
-
-
+    SDL_AtomicSet(&shared.quit, 1);
+    SDL_WaitThread(emulation, 0);
+    audio_close(&shared.audio);
+    if(capture_name){
+        recorder_stop(&recorder);
+        if(recorder.dropped){
+            printf("%lu frames could not be recorded\n", recorder.dropped);
+        }
+    }
+    renderer_destroy(&renderer);
     SDL_DestroyWindow(window);
     return 0;
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include "memory.h"
+#include "dispatch.h"
+#include "fusion.h"
 
 static void out_of_bound(int index){
     assert(index >= 0 && index < 4096);
@@ -8,6 +10,11 @@ static void out_of_bound(int index){
 void memory_set(struct memory* mem, int index, unsigned char value){
     out_of_bound(index);
     mem->memory_array[index] = value;
+    mem->page_version[index / MEMORY_PAGE_SIZE] += 1;
+    // the byte belongs to the instruction at index or index - 1, or to a fused one (see fusion.c) that started up to 5 bytes before it
+    for(int i = index >= MEMORY_MAX_SPAN - 1 ? index - (MEMORY_MAX_SPAN - 1) : 0; i <= index; i++){
+        mem->decoded[i].handler = 0;
+    }
 }
 unsigned char memory_get(struct memory* mem, int index){
     out_of_bound(index);
@@ -17,4 +24,22 @@ unsigned short memory_get_short(struct memory* mem, int index){
     unsigned char byte1 = memory_get(mem, index);
     unsigned char byte2 = memory_get(mem, index + 1);
     return byte1 << 8 | byte2;
-}
\ No newline at end of file
+}
+const struct instruction* memory_get_instruction(struct memory* mem, int index){
+    out_of_bound(index);
+    struct instruction* ins = &mem->decoded[index];
+    if(!ins->handler){
+        // the second byte of an instruction at 0xFFF wraps around to 0 instead of tripping the assert in memory_get()
+        *ins = *decode(mem->memory_array[index] << 8 | mem->memory_array[(index + 1) & 0x0fff]);
+        fuse(mem, index, ins);
+    }
+    return ins;
+}
+void memory_invalidate(struct memory* mem, int index, int size){
+    // an instruction starting a few bytes before the range can still reach into it
+    int start = index >= MEMORY_MAX_SPAN - 1 ? index - (MEMORY_MAX_SPAN - 1) : 0;
+    for(int i = start; i < index + size && i < 4096; i++){
+        mem->decoded[i].handler = 0;
+        mem->page_version[i / MEMORY_PAGE_SIZE] += 1;
+    }
+}
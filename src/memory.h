@@ -1,12 +1,31 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include "instruction.h"
+
+#define MEMORY_PAGE_SIZE 64
+#define MEMORY_PAGES (4096 / MEMORY_PAGE_SIZE)
+// most bytes a single entry in decoded can be built from, a fused sequence of 3 instructions
+#define MEMORY_MAX_SPAN 6
+
 struct memory{
     unsigned char memory_array[4096];
+    // decoded instruction starting at each address, an entry with no handler has not been decoded yet
+    // filled the first time an address is fetched and cleared again when memory_set() writes to one of its bytes
+    // an entry can be a fused run of up to 3 instructions (see fusion.c), so only step() should run these
+    struct instruction decoded[4096];
+    // bumped on every write into the matching 64 byte page, lets code built on top of several instructions (like blocks)
+    // find out if it has been written over without checking each instruction, the extra page past the end is never written
+    // so code that ends on the last page can always look at the page after it
+    unsigned int page_version[MEMORY_PAGES + 1];
 };
 
 void memory_set(struct memory* mem, int index, unsigned char value);
 unsigned char memory_get(struct memory* mem, int index);
 unsigned short memory_get_short(struct memory* mem, int index);
+// returns the decoded instruction at index, decoding it only if it is not already cached
+const struct instruction* memory_get_instruction(struct memory* mem, int index);
+// drops the cached instructions that overlap the size bytes starting at index, for writes that bypass memory_set()
+void memory_invalidate(struct memory* mem, int index, int size);
 
-#endif 
\ No newline at end of file
+#endif 
@@ -0,0 +1,63 @@
+#include "pipeline.h"
+#include <string.h>
+
+#define FRAME_FRESH 4
+#define FRAME_INDEX 3
+
+void frame_exchange_init(struct frame_exchange* exchange){
+    memset(exchange, 0, sizeof(struct frame_exchange));
+    exchange->back = 0;
+    SDL_AtomicSet(&exchange->middle, 1);
+    exchange->front = 2;
+}
+
+struct screen* frame_back(struct frame_exchange* exchange){
+    return &exchange->frames[exchange->back];
+}
+
+void frame_publish(struct frame_exchange* exchange){
+    // everything written into the frame has to be visible before the consumer can get hold of it
+    SDL_MemoryBarrierRelease();
+    int old = SDL_AtomicSet(&exchange->middle, exchange->back | FRAME_FRESH);
+    // whatever was in the middle becomes the next back frame, if the consumer never took it that frame is dropped
+    exchange->back = old & FRAME_INDEX;
+}
+
+const struct screen* frame_take(struct frame_exchange* exchange){
+    if(!(SDL_AtomicGet(&exchange->middle) & FRAME_FRESH)){
+        return 0;
+    }
+    int old = SDL_AtomicSet(&exchange->middle, exchange->front);
+    SDL_MemoryBarrierAcquire();
+    exchange->front = old & FRAME_INDEX;
+    return &exchange->frames[exchange->front];
+}
+
+void key_queue_init(struct key_queue* queue){
+    memset(queue, 0, sizeof(struct key_queue));
+}
+
+bool key_queue_push(struct key_queue* queue, struct key_event event){
+    int tail = SDL_AtomicGet(&queue->tail);
+    if(tail - SDL_AtomicGet(&queue->head) == KEY_QUEUE_SIZE){
+        return false;
+    }
+    queue->events[tail % KEY_QUEUE_SIZE] = event;
+    // the event has to be in place before the consumer can see the new tail
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue->tail, tail + 1);
+    return true;
+}
+
+bool key_queue_pop(struct key_queue* queue, struct key_event* event){
+    int head = SDL_AtomicGet(&queue->head);
+    if(head == SDL_AtomicGet(&queue->tail)){
+        return false;
+    }
+    SDL_MemoryBarrierAcquire();
+    *event = queue->events[head % KEY_QUEUE_SIZE];
+    // done reading the slot before the producer is allowed to write over it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&queue->head, head + 1);
+    return true;
+}
@@ -0,0 +1,50 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdbool.h>
+#include "SDL2/SDL.h"
+#include "screen.h"
+
+// hands finished frames from the emulation thread to the render thread without either one waiting on the other
+// there are 3 frames: the producer draws into back, the consumer shows front, and the two swap with the one in
+// the middle through a single atomic exchange. the consumer always gets the newest frame, older ones are dropped
+struct frame_exchange{
+    struct screen frames[3];
+    // index of the frame in the middle, FRAME_FRESH is set while it holds a frame the consumer has not taken yet
+    SDL_atomic_t middle;
+    // only ever touched by the producer
+    int back;
+    // only ever touched by the consumer
+    int front;
+};
+
+void frame_exchange_init(struct frame_exchange* exchange);
+// producer side, the frame to fill in and then hand over with frame_publish()
+struct screen* frame_back(struct frame_exchange* exchange);
+void frame_publish(struct frame_exchange* exchange);
+// consumer side, the newest published frame, or 0 if nothing new came in since the last call
+const struct screen* frame_take(struct frame_exchange* exchange);
+
+#define KEY_QUEUE_SIZE 64
+
+struct key_event{
+    // chip8 key, 0 to F
+    char key;
+    bool down;
+};
+
+// single producer single consumer ring for key events, the input thread pushes and the emulation thread pops
+struct key_queue{
+    struct key_event events[KEY_QUEUE_SIZE];
+    // both only ever go up, an event is at index % KEY_QUEUE_SIZE
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+};
+
+void key_queue_init(struct key_queue* queue);
+// false if the queue is full, the event is dropped
+bool key_queue_push(struct key_queue* queue, struct key_event event);
+// false if the queue is empty
+bool key_queue_pop(struct key_queue* queue, struct key_event* event);
+
+#endif
@@ -0,0 +1,69 @@
+#include "recorder.h"
+#include <string.h>
+
+// everything that is in the ring goes to the file, the bytes between head and tail can wrap around the end of it
+static void write_out(struct recorder* recorder){
+    unsigned head = SDL_AtomicGet(&recorder->head);
+    unsigned tail = SDL_AtomicGet(&recorder->tail);
+    SDL_MemoryBarrierAcquire();
+    while(head != tail){
+        unsigned start = head % RECORDER_RING_SIZE;
+        unsigned size = tail - head;
+        if(start + size > RECORDER_RING_SIZE){
+            size = RECORDER_RING_SIZE - start;
+        }
+        fwrite(&recorder->ring[start], 1, size, recorder->file);
+        head += size;
+    }
+    // done reading before the producer can write over it
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&recorder->head, head);
+}
+
+static int write_frames(void* data){
+    struct recorder* recorder = data;
+    while(!SDL_AtomicGet(&recorder->quit)){
+        write_out(recorder);
+        SDL_Delay(10);
+    }
+    write_out(recorder);
+    return 0;
+}
+
+bool recorder_start(struct recorder* recorder, const char* path){
+    memset(recorder, 0, sizeof(struct recorder));
+    recorder->file = fopen(path, "wb");
+    if(!recorder->file){
+        return false;
+    }
+    fwrite(CAPTURE_MAGIC, 1, CAPTURE_MAGIC_SIZE, recorder->file);
+    capture_encoder_init(&recorder->encoder);
+    recorder->thread = SDL_CreateThread(write_frames, "recorder", recorder);
+    return true;
+}
+
+void recorder_stop(struct recorder* recorder){
+    SDL_AtomicSet(&recorder->quit, 1);
+    SDL_WaitThread(recorder->thread, 0);
+    fclose(recorder->file);
+}
+
+void recorder_add(struct recorder* recorder, const struct screen* screen, uint32_t time){
+    unsigned tail = SDL_AtomicGet(&recorder->tail);
+    // the frame is only encoded if the ring has room for the biggest one it could be, otherwise it is left out
+    // and the next frame is a key frame so nothing after the gap depends on it
+    if(RECORDER_RING_SIZE - (tail - (unsigned)SDL_AtomicGet(&recorder->head)) < CAPTURE_FRAME_MAX){
+        capture_skip(&recorder->encoder);
+        recorder->dropped += 1;
+        return;
+    }
+    unsigned char record[CAPTURE_FRAME_MAX];
+    int size = capture_encode(&recorder->encoder, screen, time, record);
+    unsigned start = tail % RECORDER_RING_SIZE;
+    int first = size < (int)(RECORDER_RING_SIZE - start) ? size : (int)(RECORDER_RING_SIZE - start);
+    memcpy(&recorder->ring[start], record, first);
+    memcpy(&recorder->ring[0], record + first, size - first);
+    // the bytes have to be in place before the writer can see the new tail
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&recorder->tail, tail + size);
+}
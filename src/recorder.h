@@ -0,0 +1,35 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "SDL2/SDL.h"
+#include "capture.h"
+
+// room for a few seconds of frames even if the disk stalls, a frame is rarely more than a few dozen bytes
+#define RECORDER_RING_SIZE (1 << 18)
+
+// records the frames the frontend shows into a capture file (see capture.h). the frontend only encodes the frame,
+// which is a few XORs, and copies it into a ring. a thread of its own does the writing so the disk never holds up a frame
+struct recorder{
+    FILE* file;
+    struct capture_encoder encoder;
+    // single producer single consumer ring of encoded bytes. head and tail only ever go up (wrapping around as unsigned)
+    // and a byte is at index % RECORDER_RING_SIZE
+    unsigned char ring[RECORDER_RING_SIZE];
+    SDL_atomic_t head;
+    SDL_atomic_t tail;
+    SDL_atomic_t quit;
+    SDL_Thread* thread;
+    // frames that were left out because the ring was full
+    unsigned long dropped;
+};
+
+// opens path and starts the writer thread, false if the file can't be made
+bool recorder_start(struct recorder* recorder, const char* path);
+// writes out what is left in the ring and closes the file
+void recorder_stop(struct recorder* recorder);
+// adds a frame shown at time, in milliseconds
+void recorder_add(struct recorder* recorder, const struct screen* screen, uint32_t time);
+
+#endif
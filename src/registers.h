@@ -1,19 +1,58 @@
 #ifndef REGISTERS_H
 #define REGISTERS_H
 
+#include <stdint.h>
+
 struct registers{
     // one char in C is 1 byte = 8 bit 
     unsigned char V[16];
     // special 16 bit register in chip-8, used to store memory address
     unsigned short I;
-    // see section 2.5 reference
-    unsigned char delay_timer;
-    // see section 2.5 reference
-    unsigned char sound_timer;
+    // see section 2.5 reference. the delay and sound timers are kept as the tick they run out on instead of what is
+    // left of them, so a tick is one add and nothing counts them down. go through the functions below for their values
+    uint64_t delay_expiry;
+    uint64_t sound_expiry;
+    // how many 60Hz ticks have gone by, the timers count down against this
+    uint64_t ticks;
     // 16bit, points to the next instruction that will be run after the current one
     unsigned short program_counter;
     // 8 bit, points to the topmost level of the stack
     unsigned char stack_pointer;
+    // XO-CHIP audio. the 16 bytes F002 loaded from [I], played as 128 1 bit samples while the sound timer runs, and
+    // the Fx3A pitch they play at, 4000 * 2^((pitch - 64) / 48) samples a second. pattern_version goes up on every
+    // F002 so the frontend can tell a new pattern came in without comparing them
+    unsigned char pattern[16];
+    unsigned char pattern_version;
+    unsigned char pitch;
 };
 
+static inline unsigned char timer_left(const struct registers* reg, uint64_t expiry){
+    return expiry > reg->ticks ? expiry - reg->ticks : 0;
+}
+
+// what Fx07 reads
+static inline unsigned char delay_timer_get(const struct registers* reg){
+    return timer_left(reg, reg->delay_expiry);
+}
+
+// Fx15
+static inline void delay_timer_set(struct registers* reg, unsigned char value){
+    reg->delay_expiry = reg->ticks + value;
+}
+
+// the sound plays while this is above 0
+static inline unsigned char sound_timer_get(const struct registers* reg){
+    return timer_left(reg, reg->sound_expiry);
+}
+
+// Fx18
+static inline void sound_timer_set(struct registers* reg, unsigned char value){
+    reg->sound_expiry = reg->ticks + value;
+}
+
+// both timers go down by 1, or stay at 0
+static inline void timers_tick(struct registers* reg){
+    reg->ticks += 1;
+}
+
 #endif
\ No newline at end of file
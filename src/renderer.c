@@ -0,0 +1,84 @@
+#include "renderer.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool renderer_create(struct renderer* renderer, SDL_Window* window, const uint32_t palette[2]){
+    memset(renderer, 0, sizeof(struct renderer));
+    // nearest neighbour, every chip8 pixel stays a sharp square however big the window is
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    renderer->renderer = SDL_CreateRenderer(window, -1, 0);
+    if(!renderer->renderer){
+        return false;
+    }
+    renderer->scale = 1;
+    SDL_RendererInfo info;
+    if(SDL_GetRendererInfo(renderer->renderer, &info) == 0 && !(info.flags & SDL_RENDERER_ACCELERATED)){
+        int window_width, window_height;
+        SDL_GetWindowSize(window, &window_width, &window_height);
+        int scale_x = window_width / HIRES_WIDTH;
+        int scale_y = window_height / HIRES_HEIGHT;
+        renderer->scale = scale_x < scale_y ? scale_x : scale_y;
+        if(renderer->scale < 1){
+            renderer->scale = 1;
+        }
+    }
+    renderer->width = HIRES_WIDTH * renderer->scale;
+    renderer->height = HIRES_HEIGHT * renderer->scale;
+    renderer->pixels = malloc(renderer->width * renderer->height * sizeof(uint32_t));
+    if(!renderer->pixels || !scaler_init(&renderer->lores, renderer->scale * 2, palette) || !scaler_init(&renderer->hires, renderer->scale, palette)){
+        renderer_destroy(renderer);
+        return false;
+    }
+    renderer->texture = SDL_CreateTexture(renderer->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, renderer->width, renderer->height);
+    if(!renderer->texture){
+        renderer_destroy(renderer);
+        return false;
+    }
+    for(int i = 0; i < renderer->width * renderer->height; i++){
+        renderer->pixels[i] = palette[0];
+    }
+    SDL_UpdateTexture(renderer->texture, NULL, renderer->pixels, renderer->width * sizeof(uint32_t));
+    renderer->frame_ticks = SDL_GetPerformanceFrequency() / 60;
+    renderer->stale = true;
+    return true;
+}
+
+void renderer_destroy(struct renderer* renderer){
+    if(renderer->texture){
+        SDL_DestroyTexture(renderer->texture);
+    }
+    SDL_DestroyRenderer(renderer->renderer);
+    scaler_free(&renderer->lores);
+    scaler_free(&renderer->hires);
+    free(renderer->pixels);
+}
+
+void renderer_invalidate(struct renderer* renderer){
+    renderer->stale = true;
+}
+
+bool renderer_present(struct renderer* renderer, struct screen* screen){
+    uint64_t now = SDL_GetPerformanceCounter();
+    if(now - renderer->last_present < renderer->frame_ticks){
+        return false;
+    }
+    // the changes are only taken once it is time to present, so anything drawn in between piles up for the next frame
+    struct screen_dirty dirty;
+    bool changed = screen_take_dirty(screen, &dirty);
+    if(!changed && !renderer->stale){
+        return false;
+    }
+    if(changed){
+        const struct scaler* scaler = screen->hires ? &renderer->hires : &renderer->lores;
+        scaler_draw(scaler, screen, renderer->pixels, renderer->width, dirty.rows);
+        // one upload for the band of rows that changed, the rest of the texture still holds the last frame
+        SDL_Rect rows = {0, dirty.y * scaler->scale, renderer->width, dirty.h * scaler->scale};
+        SDL_UpdateTexture(renderer->texture, &rows, &renderer->pixels[rows.y * renderer->width], renderer->width * sizeof(uint32_t));
+    }
+    // the texture is stretched over the whole window
+    SDL_RenderCopy(renderer->renderer, renderer->texture, NULL, NULL);
+    SDL_RenderPresent(renderer->renderer);
+    renderer->last_present = now;
+    renderer->stale = false;
+    return true;
+}
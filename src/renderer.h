@@ -0,0 +1,40 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "SDL2/SDL.h"
+#include "screen.h"
+#include "scaler.h"
+
+// draws struct screen into a window through one streaming texture, so a frame is one texture update and one copy
+// instead of a rectangle per pixel. with a gpu the texture is the size of the hi-res display and SDL scales it up to
+// the window. without one SDL would scale it pixel by pixel in software, so the texture is made as big as the window
+// and the scalers (see scaler.h) fill it
+struct renderer{
+    SDL_Renderer* renderer;
+    SDL_Texture* texture;
+    // how many texture pixels a hi-res pixel is, a lo-res pixel is twice that
+    int scale;
+    int width;
+    int height;
+    struct scaler lores;
+    struct scaler hires;
+    // what is in the texture, width by height. only the rows that changed get converted again
+    uint32_t* pixels;
+    // SDL_GetPerformanceCounter() at the last present and how many of its ticks make up a 60Hz frame
+    uint64_t last_present;
+    uint64_t frame_ticks;
+    // the window lost what was drawn in it, the next present has to happen even if the screen did not change
+    bool stale;
+};
+
+// palette is the colour of a pixel that is off and of one that is on, as ARGB8888
+bool renderer_create(struct renderer* renderer, SDL_Window* window, const uint32_t palette[2]);
+void renderer_destroy(struct renderer* renderer);
+// for window events, the next renderer_present() draws everything again
+void renderer_invalidate(struct renderer* renderer);
+// shows the screen if it changed and a 60Hz frame has gone by since the last present, returns true if it did
+bool renderer_present(struct renderer* renderer, struct screen* screen);
+
+#endif
@@ -0,0 +1,57 @@
+#include "scaler.h"
+#include <stdlib.h>
+#include <string.h>
+
+bool scaler_init(struct scaler* scaler, int scale, const uint32_t palette[2]){
+    scaler->scale = scale;
+    scaler->palette[0] = palette[0];
+    scaler->palette[1] = palette[1];
+    int span = 8 * scale;
+    scaler->table = malloc(256 * span * sizeof(uint32_t));
+    if(!scaler->table){
+        return false;
+    }
+    for(int byte = 0; byte < 256; byte++){
+        uint32_t* out = &scaler->table[byte * span];
+        for(int bit = 0; bit < 8; bit++){
+            uint32_t colour = palette[byte >> (7 - bit) & 1];
+            for(int i = 0; i < scale; i++){
+                *out++ = colour;
+            }
+        }
+    }
+    return true;
+}
+
+void scaler_free(struct scaler* scaler){
+    free(scaler->table);
+    scaler->table = 0;
+}
+
+// the 64 pixels of one word, leftmost byte first. each table entry is a run of 32 * scale bytes, which memcpy moves
+// with the widest stores the cpu has
+static inline void draw_word(const struct scaler* scaler, uint64_t word, uint32_t* line){
+    int span = 8 * scaler->scale;
+    for(int i = 0; i < 8; i++){
+        memcpy(line, &scaler->table[(word >> (56 - 8 * i) & 0xff) * span], span * sizeof(uint32_t));
+        line += span;
+    }
+}
+
+void scaler_draw(const struct scaler* scaler, const struct screen* screen, uint32_t* pixels, int pitch, uint64_t rows){
+    int scale = scaler->scale;
+    int line_size = screen_width(screen) * scale * sizeof(uint32_t);
+    for(int y = 0; y < screen_height(screen); y++){
+        if(!(rows & (uint64_t)1 << y)){
+            continue;
+        }
+        uint32_t* line = &pixels[y * scale * pitch];
+        int words = screen_row_words(screen);
+        for(int i = 0; i < words; i++){
+            draw_word(scaler, screen->rows[y * words + i], line + i * 64 * scale);
+        }
+        for(int i = 1; i < scale; i++){
+            memcpy(line + i * pitch, line, line_size);
+        }
+    }
+}
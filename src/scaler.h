@@ -0,0 +1,26 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "screen.h"
+
+// turns the packed rows of struct screen into ARGB8888 pixels scale times bigger, for drawing without a gpu to scale
+// the picture up. every byte of a row is looked up in a table that holds the 8 * scale pixels it turns into, so a
+// row is 8 or 16 copies out of the table, and the other scale - 1 lines of it are copies of the first
+struct scaler{
+    int scale;
+    // the colours for a pixel that is off and on
+    uint32_t palette[2];
+    // 256 entries of 8 * scale pixels, entry b is what byte b of a row turns into
+    uint32_t* table;
+};
+
+// false if there is no memory for the table, palette is the off and the on colour
+bool scaler_init(struct scaler* scaler, int scale, const uint32_t palette[2]);
+void scaler_free(struct scaler* scaler);
+// writes the rows of screen that are set in rows (bit y for row y) into pixels, pitch is how many pixels apart the
+// lines of pixels are. pixels has to have room for screen_width(screen) * scale by screen_height(screen) * scale
+void scaler_draw(const struct scaler* scaler, const struct screen* screen, uint32_t* pixels, int pitch, uint64_t rows);
+
+#endif
@@ -0,0 +1,17 @@
+#include "scheduler.h"
+#include "chip8.h"
+
+void scheduler_init(struct scheduler* scheduler, long rate){
+    scheduler->rate = rate;
+    scheduler->cycle = 0;
+    scheduler->ticks = 0;
+}
+
+void scheduler_tick(struct scheduler* scheduler, struct chip8* chip8){
+    uint64_t tick = scheduler_next_tick(scheduler);
+    if(scheduler->cycle < tick){
+        scheduler->cycle = tick;
+    }
+    scheduler->ticks += 1;
+    timers_tick(&chip8->reg);
+}
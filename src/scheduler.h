@@ -0,0 +1,46 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+struct chip8;
+
+#define SCHEDULER_TICKS_PER_SECOND 60
+// what the frontends ran at before the rate could be picked, 10 instructions a tick
+#define SCHEDULER_DEFAULT_RATE 600
+
+// emulated time, counted in instructions. a second of it is rate instructions and the delay and sound timers tick
+// 60 times in it, tick n on instruction n * rate / 60, so the timers keep the same pace against the program whatever
+// the rate is (it doesn't have to be a multiple of 60) and however fast or unevenly the host gets to run it.
+// the frontend only has to line the ticks up with the wall clock
+struct scheduler{
+    // instructions in a second of emulated time
+    long rate;
+    // instructions so far, including the ones an idle program or one waiting on a key spent doing nothing
+    uint64_t cycle;
+    // how many times the timers have ticked
+    uint64_t ticks;
+};
+
+void scheduler_init(struct scheduler* scheduler, long rate);
+// ticks the timers of chip8 and moves the cycle up to the tick, the instructions that weren't run before it are
+// time the program spent waiting
+void scheduler_tick(struct scheduler* scheduler, struct chip8* chip8);
+
+// the instruction the timers tick on next
+static inline uint64_t scheduler_next_tick(const struct scheduler* scheduler){
+    return (scheduler->ticks + 1) * scheduler->rate / SCHEDULER_TICKS_PER_SECOND;
+}
+
+// how many instructions can run before the timers tick, 0 or less once they are due. chip8_run() can go a little
+// past what it is asked for so this can end up below 0
+static inline long scheduler_due(const struct scheduler* scheduler){
+    return (long)(scheduler_next_tick(scheduler) - scheduler->cycle);
+}
+
+// counts instructions that were run
+static inline void scheduler_advance(struct scheduler* scheduler, long count){
+    scheduler->cycle += count;
+}
+
+#endif
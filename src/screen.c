@@ -1,47 +1,361 @@
 #include "screen.h"
+#include "screen_simd.h"
 #include <assert.h>
 #include <string.h>
 
-void screen_out_of_bound(int x, int y){
-    assert(x >= 0 && x < 64 && y >= 0 && y < 32 );
+// what hi-res adds to the hash, so a blank hi-res screen does not hash the same as a blank lo-res one
+#define HIRES_HASH 0x2545f4914f6cdd1dULL
+
+void screen_out_of_bound(struct screen* screen, int x, int y){
+    assert(x >= 0 && x < screen_width(screen) && y >= 0 && y < screen_height(screen));
+}
+
+// the bit for column x in a row
+static inline uint64_t pixel_bit(int x){
+    return (uint64_t)1 << (63 - x);
+}
+
+// moves the pixels of a row right by shift, the ones that go past the right edge come back in on the left
+static inline uint64_t rotate(uint64_t bits, int shift){
+    return shift ? bits >> shift | bits << (64 - shift) : bits;
+}
+
+// the same for a 128 pixel hi-res row made of its left and right words
+static inline void rotate_wide(uint64_t* left, uint64_t* right, int shift){
+    if(shift >= 64){
+        uint64_t tmp = *left;
+        *left = *right;
+        *right = tmp;
+        shift -= 64;
+    }
+    if(shift){
+        uint64_t l = *left;
+        uint64_t r = *right;
+        *left = l >> shift | r << (64 - shift);
+        *right = r >> shift | l << (64 - shift);
+    }
+}
+
+// every change to the rows goes through here so the next screen_take_dirty() knows about it
+static inline void mark_dirty(struct screen* screen, uint64_t rows, uint64_t columns, uint64_t right){
+    screen->dirty_rows |= rows;
+    screen->dirty_columns |= columns;
+    screen->dirty_right |= right;
+}
+
+// one bit for each row of the current mode
+static inline uint64_t all_rows(const struct screen* screen){
+    return screen->hires ? ~(uint64_t)0 : 0xffffffff;
+}
+
+// murmur3's 64 bit finalizer, every bit of the input changes about half of the output
+static inline uint64_t mix(uint64_t h){
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// the left word of row y uses key y and the right word of a hi-res row key 64 + y
+static inline uint64_t row_key(int y){
+    return (uint64_t)(y + 1) * 0x9e3779b97f4a7c15ULL;
+}
+// what row y holding these pixels adds to the hash. the screen hash is all of these XORed together, so changing a row
+// only takes its old value out and puts the new one in. a blank row adds 0 so a blank screen hashes to 0
+static inline uint64_t row_hash(int y, uint64_t row){
+    return mix(row ^ row_key(y)) ^ mix(row_key(y));
+}
+// the same as row_hash(y, from) ^ row_hash(y, to), the parts for a blank row cancel out
+static inline uint64_t row_change(int y, uint64_t from, uint64_t to){
+    return mix(from ^ row_key(y)) ^ mix(to ^ row_key(y));
+}
+
+uint64_t screen_rehash(const struct screen* screen){
+    uint64_t hash = screen->hires ? HIRES_HASH : 0;
+    if(!screen->hires){
+        for(int y = 0; y < SCREEN_HEIGHT; y++){
+            hash ^= row_hash(y, screen->rows[y]);
+        }
+        return hash;
+    }
+    for(int y = 0; y < HIRES_HEIGHT; y++){
+        hash ^= row_hash(y, screen->rows[y * 2]) ^ row_hash(64 + y, screen->rows[y * 2 + 1]);
+    }
+    return hash;
 }
 
 void screen_set(struct screen* screen, int x, int y){
-    screen_out_of_bound(x, y);
-    screen->pixels_array[y][x] = true;
+    screen_out_of_bound(screen, x, y);
+    uint64_t* word = &screen->rows[y * screen_row_words(screen) + x / 64];
+    uint64_t bit = pixel_bit(x % 64);
+    screen->hash ^= row_change(x >= 64 ? 64 + y : y, *word, *word | bit);
+    *word |= bit;
+    mark_dirty(screen, (uint64_t)1 << y, x < 64 ? bit : 0, x >= 64 ? bit : 0);
 }
 bool is_screen_set(struct screen* screen, int x, int y){
-    screen_out_of_bound(x, y);
-    return screen->pixels_array[y][x];
+    screen_out_of_bound(screen, x, y);
+    return (screen->rows[y * screen_row_words(screen) + x / 64] & pixel_bit(x % 64)) != 0;
+}
+
+// XORs one 16 pixel row of a lo-res Dxy0 into the screen at (x, y), bits holds the sprite pixels in its highest bits.
+// the kernels take one byte per row in lo-res, so this is the plain way one row at a time. returns true if a pixel
+// got erased
+static bool blit_row(struct screen* screen, int x, int y, uint64_t bits){
+    if(!bits){
+        return false;
+    }
+    y %= 32;
+    bits = rotate(bits, x % 64);
+    uint64_t old = screen->rows[y];
+    screen->rows[y] = old ^ bits;
+    screen->hash ^= row_change(y, old, old ^ bits);
+    mark_dirty(screen, (uint64_t)1 << y, bits, 0);
+    return (old & bits) != 0;
+}
+
+// hi-res sprites, count rows of bytes each (1 for Dxyn, 2 for Dxy0) through the 128 pixel kernels. the rows wrap
+// from the bottom back to the top the same way as in lo-res
+static bool draw_wide(struct screen* screen, int x, int y, const unsigned char* sprite, int count, int bytes){
+    const struct screen_kernels* kernels = screen_kernels();
+    int top = y % 64;
+    int shift = x % 128;
+    int first = count < 64 - top ? count : 64 - top;
+    uint64_t collision = kernels->blit_wide(&screen->rows[top * 2], sprite, first, bytes, shift);
+    if(first < count){
+        collision |= kernels->blit_wide(&screen->rows[0], sprite + first * bytes, count - first, bytes, shift);
+    }
+    // the same as draw_sprite(), each word held new ^ sprite before the blit
+    uint64_t rows = 0;
+    uint64_t columns = 0;
+    uint64_t right = 0;
+    for(int ly = 0; ly < count; ly++){
+        uint64_t left = bytes == 2 ? (uint64_t)(sprite[ly * 2] << 8 | sprite[ly * 2 + 1]) << 48 : (uint64_t)sprite[ly] << 56;
+        if(!left){
+            continue;
+        }
+        uint64_t carry = 0;
+        rotate_wide(&left, &carry, shift);
+        int row = (top + ly) % 64;
+        uint64_t* words = &screen->rows[row * 2];
+        screen->hash ^= row_change(row, words[0] ^ left, words[0]) ^ row_change(64 + row, words[1] ^ carry, words[1]);
+        rows |= (uint64_t)1 << row;
+        columns |= left;
+        right |= carry;
+    }
+    mark_dirty(screen, rows, columns, right);
+    return collision != 0;
 }
 
 bool draw_sprite(struct screen* screen, int x, int y, const char* sprite_ptr, int num_byte){
-    bool sprite_collision  = false;
+    const unsigned char* sprite = (const unsigned char*) sprite_ptr;
+    if(screen->hires){
+        return draw_wide(screen, x, y, sprite, num_byte, 1);
+    }
+    const struct screen_kernels* kernels = screen_kernels();
+    // each sprite byte goes in the leftmost 8 pixels and is then rotated over to x, so it wraps around the screen
+    // the same way the % 64 on every pixel did. the rows wrap from the bottom back to the top, so a sprite that
+    // goes past row 31 is done as two runs of rows
+    int top = y % 32;
+    int first = num_byte < 32 - top ? num_byte : 32 - top;
+    // any pixel that is set on both gets erased by the XOR, which is a collision (VF = 1)
+    uint64_t collision = kernels->blit(&screen->rows[top], sprite, first, x % 64);
+    if(first < num_byte){
+        collision |= kernels->blit(&screen->rows[0], sprite + first, num_byte - first, x % 64);
+    }
+    // a row only changes if its sprite byte has a pixel set, and the columns are the ones any of the bytes cover.
+    // the row held new ^ sprite before the blit, which is all the hash needs to swap the old row for the new one
+    uint64_t rows = 0;
+    unsigned char columns = 0;
+    int shift = x % 64;
     for(int ly = 0; ly < num_byte; ly++){
-        char c = sprite_ptr[ly];
-        for(int lx = 0; lx < 8; lx++){
-            // determining whether we should draw a pixel or not, suppose that we have 11011111, we AND this with 0b10000000, if the result
-            // is bigger than 0, that means we have a 1, meaning that we need to draw a pixel, we then shift 1 from 0b10000000 to the left
-            // which becomes 0b01000000, and we keep doing this operation. if we have 0 AND 1, we know that the result will be 0, so we don't
-            // have to draw a pixel there, there is nothing to do in this case, so simply continue onto the next loop and skip the drawing part. 
-            if((c & (0b10000000 >> lx)) == 0){
-                continue;
+        if(sprite[ly]){
+            int row = (top + ly) % 32;
+            uint64_t bits = rotate((uint64_t)sprite[ly] << 56, shift);
+            screen->hash ^= row_change(row, screen->rows[row] ^ bits, screen->rows[row]);
+            rows |= (uint64_t)1 << row;
+            columns |= sprite[ly];
+        }
+    }
+    mark_dirty(screen, rows, rotate((uint64_t)columns << 56, shift), 0);
+    return collision != 0;
+}
+
+bool draw_large_sprite(struct screen* screen, int x, int y, const char* sprite_ptr){
+    const unsigned char* sprite = (const unsigned char*) sprite_ptr;
+    if(screen->hires){
+        return draw_wide(screen, x, y, sprite, 16, 2);
+    }
+    bool collision = false;
+    for(int ly = 0; ly < 16; ly++){
+        uint64_t bits = (uint64_t)(sprite[ly * 2] << 8 | sprite[ly * 2 + 1]) << 48;
+        collision |= blit_row(screen, x, y + ly, bits);
+    }
+    return collision;
+}
+
+// every row that has anything on it, before or after a change that can touch all of them
+static void mark_lit_rows(struct screen* screen){
+    uint64_t rows = 0;
+    uint64_t columns = 0;
+    uint64_t right = 0;
+    if(!screen->hires){
+        for(int y = 0; y < SCREEN_HEIGHT; y++){
+            if(screen->rows[y]){
+                rows |= (uint64_t)1 << y;
+                columns |= screen->rows[y];
             }
-            // x and y is the position of the first pixel, we then draw other pixels depending on the result from above if statement
-            // so if at position lx = 2, we got a non-zero result, we then have to draw pixel at x and x+2 and so on.
-            // modulo used to make sure the sprite wraps around the screen, meaning that if we go off bound, then the other part of sprit
-            // shows up at x or y = 0. e.g 
-            if(screen->pixels_array[(ly+y) % 32][(lx+x) % 64]){
-                sprite_collision  = true;
+        }
+    }
+    else{
+        for(int y = 0; y < HIRES_HEIGHT; y++){
+            if(screen->rows[y * 2] | screen->rows[y * 2 + 1]){
+                rows |= (uint64_t)1 << y;
+                columns |= screen->rows[y * 2];
+                right |= screen->rows[y * 2 + 1];
             }
-            // we use XOR = true -> required from technical reference, if this causes any pixels to be erased Vf should be set to 1, 0 otherwise
-            screen->pixels_array[(ly+y) % 32][(lx+x) % 64] ^= true;
         }
     }
-
-    return sprite_collision;
+    mark_dirty(screen, rows, columns, right);
 }
 
 void clear(struct screen* screen){
-    memset(screen->pixels_array, 0, sizeof(screen->pixels_array));
-}
\ No newline at end of file
+    // clearing a screen that is already blank changes nothing
+    mark_lit_rows(screen);
+    // memset is already as fast as it gets for 256 bytes, and in lo-res that is all there is to clear
+    memset(screen->rows, 0, screen_height(screen) * screen_row_words(screen) * sizeof(screen->rows[0]));
+    screen->hash = screen->hires ? HIRES_HASH : 0;
+}
+
+void screen_set_hires(struct screen* screen, bool hires){
+    if(screen->hires == hires){
+        return;
+    }
+    clear(screen);
+    screen->hires = hires;
+    screen->hash = hires ? HIRES_HASH : 0;
+    // the frontend has to draw all of it again at the new size, what changed at the old size doesn't matter anymore
+    screen->dirty_rows = all_rows(screen);
+    screen->dirty_columns = ~(uint64_t)0;
+    screen->dirty_right = hires ? ~(uint64_t)0 : 0;
+}
+
+void scroll_down(struct screen* screen, int n){
+    int height = screen_height(screen);
+    mark_lit_rows(screen);
+    if(n >= height){
+        clear(screen);
+        return;
+    }
+    int words = screen_row_words(screen);
+    memmove(&screen->rows[n * words], &screen->rows[0], (height - n) * words * sizeof(screen->rows[0]));
+    memset(&screen->rows[0], 0, n * words * sizeof(screen->rows[0]));
+    mark_lit_rows(screen);
+    // every row can move, so the hash is worked out again
+    screen->hash = screen_rehash(screen);
+}
+// hi-res rows carry pixels between their two words, which the wide kernel does
+static void scroll_sideways(struct screen* screen, int shift){
+    if(shift >= screen_width(screen) || shift <= -screen_width(screen)){
+        clear(screen);
+        return;
+    }
+    mark_lit_rows(screen);
+    if(screen->hires){
+        screen_kernels()->shift_wide(screen->rows, HIRES_HEIGHT, shift);
+    }
+    else{
+        screen_kernels()->shift(screen->rows, 32, shift);
+    }
+    mark_lit_rows(screen);
+    screen->hash = screen_rehash(screen);
+}
+void scroll_left(struct screen* screen, int n){
+    scroll_sideways(screen, n);
+}
+void scroll_right(struct screen* screen, int n){
+    scroll_sideways(screen, -n);
+}
+
+uint64_t screen_diff(const struct screen* a, const struct screen* b){
+    if(a->hires != b->hires){
+        return ~(uint64_t)0;
+    }
+    const struct screen_kernels* kernels = screen_kernels();
+    if(!a->hires){
+        return kernels->diff(a->rows, b->rows, 32);
+    }
+    return kernels->diff_wide(a->rows, b->rows, HIRES_HEIGHT);
+}
+bool screen_equal(const struct screen* a, const struct screen* b){
+    return screen_diff(a, b) == 0;
+}
+
+void screen_copy(struct screen* to, const struct screen* from){
+    if(to->hires != from->hires){
+        // a different mode means a different size, all of it has to be drawn again
+        memcpy(to->rows, from->rows, sizeof(to->rows));
+        to->hires = from->hires;
+        to->hash = from->hash;
+        to->dirty_rows = all_rows(to);
+        to->dirty_columns = ~(uint64_t)0;
+        to->dirty_right = to->hires ? ~(uint64_t)0 : 0;
+        return;
+    }
+    uint64_t rows = screen_diff(to, from);
+    uint64_t columns = 0;
+    uint64_t right = 0;
+    int height = screen_height(from);
+    int words = screen_row_words(from);
+    for(int y = 0; y < height; y++){
+        if(rows & (uint64_t)1 << y){
+            columns |= to->rows[y * words] ^ from->rows[y * words];
+            if(words == 2){
+                right |= to->rows[y * 2 + 1] ^ from->rows[y * 2 + 1];
+            }
+        }
+    }
+    // in lo-res everything past row 31 stays 0, there is nothing to copy there
+    memcpy(to->rows, from->rows, height * words * sizeof(to->rows[0]));
+    to->hash = from->hash;
+    mark_dirty(to, rows, columns, right);
+}
+
+bool screen_take_dirty(struct screen* screen, struct screen_dirty* dirty){
+    if(!screen->dirty_rows){
+        return false;
+    }
+    int top = 0;
+    while(!(screen->dirty_rows & (uint64_t)1 << top)){
+        top++;
+    }
+    int bottom = screen_height(screen) - 1;
+    while(!(screen->dirty_rows & (uint64_t)1 << bottom)){
+        bottom--;
+    }
+    // columns 0 to 63 are in dirty_columns and 64 to 127 in dirty_right, which is only used in hi-res
+    int left = 0;
+    while(left < 64 && !(screen->dirty_columns & pixel_bit(left))){
+        left++;
+    }
+    while(left < 128 && left >= 64 && !(screen->dirty_right & pixel_bit(left - 64))){
+        left++;
+    }
+    int right = screen_width(screen) - 1;
+    while(right >= 64 && !(screen->dirty_right & pixel_bit(right - 64))){
+        right--;
+    }
+    while(right > 0 && right < 64 && !(screen->dirty_columns & pixel_bit(right))){
+        right--;
+    }
+    dirty->rows = screen->dirty_rows;
+    dirty->x = left;
+    dirty->y = top;
+    dirty->w = right - left + 1;
+    dirty->h = bottom - top + 1;
+    screen->dirty_rows = 0;
+    screen->dirty_columns = 0;
+    screen->dirty_right = 0;
+    return true;
+}
@@ -2,14 +2,76 @@
 #define SCREEN_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
-// a 2d array representing the 
+#define SCREEN_WIDTH 64
+#define SCREEN_HEIGHT 32
+// the SUPER-CHIP hi-res mode, 00FF switches to it and 00FE back
+#define HIRES_WIDTH 128
+#define HIRES_HEIGHT 64
+
+// the display, one 64 bit word per row with the leftmost pixel in the highest bit
+// so a sprite byte lands on the screen with a single rotate, and a lo-res screen is 256 bytes
+// a hi-res row is 2 words next to each other, columns 0 to 63 and then 64 to 127, so the kernels in screen_simd.c
+// get a whole 128 pixel row in one load
 struct screen{
-    bool pixels_array[32][64];
+    // lo-res row y is rows[y] and only the first 32 are used, hi-res row y is rows[2 * y] and rows[2 * y + 1].
+    // whatever the current mode doesn't use is always 0
+    uint64_t rows[HIRES_HEIGHT * 2];
+    bool hires;
+    // what has changed since the last screen_take_dirty(), bit y for row y and the same layout as rows and right for the columns
+    uint64_t dirty_rows;
+    uint64_t dirty_columns;
+    uint64_t dirty_right;
+    // hash of the pixels and the mode, kept up to date on every change, 0 for a blank lo-res screen
+    uint64_t hash;
+};
+
+// the part of the screen that changed in pixels of the current mode, rows has a bit for every row that did,
+// x, y, w and h is the box around all of it
+struct screen_dirty{
+    uint64_t rows;
+    int x;
+    int y;
+    int w;
+    int h;
 };
 
+static inline int screen_width(const struct screen* screen){
+    return screen->hires ? HIRES_WIDTH : SCREEN_WIDTH;
+}
+static inline int screen_height(const struct screen* screen){
+    return screen->hires ? HIRES_HEIGHT : SCREEN_HEIGHT;
+}
+// the number of words in each row, row y starts at rows[y * screen_row_words(screen)]
+static inline int screen_row_words(const struct screen* screen){
+    return screen->hires ? 2 : 1;
+}
+
 void clear(struct screen* screen);
 void screen_set(struct screen* screen, int x, int y);
 bool is_screen_set(struct screen* screen, int x, int y);
 bool draw_sprite(struct screen* screen, int x, int y, const char* sprite_ptr, int num_byte);
-#endif
\ No newline at end of file
+// the 16x16 sprite of SUPER-CHIP's Dxy0, 2 bytes per row, returns true on a collision like draw_sprite()
+bool draw_large_sprite(struct screen* screen, int x, int y, const char* sprite_ptr);
+// 00FE and 00FF, switching to the other mode clears the screen
+void screen_set_hires(struct screen* screen, bool hires);
+// SCHIP style scrolls by n pixels of the current mode, whatever moves off the screen is gone and the space left behind is cleared
+void scroll_down(struct screen* screen, int n);
+void scroll_left(struct screen* screen, int n);
+void scroll_right(struct screen* screen, int n);
+// one bit per row (bit y for row y), set where the two screens differ, every bit is set when the modes differ
+uint64_t screen_diff(const struct screen* a, const struct screen* b);
+bool screen_equal(const struct screen* a, const struct screen* b);
+// copies the pixels of from into to and marks whatever is different as dirty in to, for keeping a copy of a screen up to date
+void screen_copy(struct screen* to, const struct screen* from);
+// for frontends, returns false if nothing changed since the last call, otherwise fills in dirty and starts tracking over
+bool screen_take_dirty(struct screen* screen, struct screen_dirty* dirty);
+// the same pixels always give the same hash, on every machine and every run, so it works for spotting a frame that
+// is the same as the last one (a sprite erased and drawn again in the same place) and for golden values in tests
+static inline uint64_t screen_hash(const struct screen* screen){
+    return screen->hash;
+}
+// works the hash out from the rows, what screen->hash is kept equal to
+uint64_t screen_rehash(const struct screen* screen);
+#endif
@@ -0,0 +1,365 @@
+#include "screen_simd.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline uint64_t rotate_right(uint64_t value, int count){
+    count &= 63;
+    return count ? (value >> count) | (value << (64 - count)) : value;
+}
+
+static inline uint64_t blit_scalar(uint64_t* rows, const unsigned char* sprite, int count, int shift){
+    uint64_t collision = 0;
+    for(int i = 0; i < count; i++){
+        uint64_t bits = rotate_right((uint64_t)sprite[i] << 56, shift);
+        collision |= rows[i] & bits;
+        rows[i] ^= bits;
+    }
+    return collision;
+}
+
+static inline void shift_scalar(uint64_t* rows, int count, int shift){
+    for(int i = 0; i < count; i++){
+        rows[i] = shift >= 0 ? rows[i] << shift : rows[i] >> -shift;
+    }
+}
+
+static inline uint64_t diff_scalar(const uint64_t* a, const uint64_t* b, int count){
+    uint64_t mask = 0;
+    for(int i = 0; i < count; i++){
+        if(a[i] != b[i]){
+            mask |= (uint64_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+// sprite row i in the highest bits of a word
+static inline uint64_t sprite_bits(const unsigned char* sprite, int i, int bytes){
+    return bytes == 2 ? (uint64_t)(sprite[i * 2] << 8 | sprite[i * 2 + 1]) << 48 : (uint64_t)sprite[i] << 56;
+}
+
+static inline uint64_t blit_wide_scalar(uint64_t* rows, const unsigned char* sprite, int count, int bytes, int shift){
+    uint64_t collision = 0;
+    int s = shift & 63;
+    for(int i = 0; i < count; i++){
+        uint64_t bits = sprite_bits(sprite, i, bytes);
+        // the pixels that stay in the word the sprite starts in and the ones that carry over into the next one,
+        // past the right edge that is the left word again
+        uint64_t stay = bits >> s;
+        uint64_t carry = s ? bits << (64 - s) : 0;
+        uint64_t left = shift < 64 ? stay : carry;
+        uint64_t right = shift < 64 ? carry : stay;
+        collision |= (rows[i * 2] & left) | (rows[i * 2 + 1] & right);
+        rows[i * 2] ^= left;
+        rows[i * 2 + 1] ^= right;
+    }
+    return collision;
+}
+
+static inline void shift_wide_scalar(uint64_t* rows, int count, int shift){
+    for(int i = 0; i < count; i++){
+        uint64_t left = rows[i * 2];
+        uint64_t right = rows[i * 2 + 1];
+        if(shift >= 64){
+            left = right << (shift - 64);
+            right = 0;
+        }
+        else if(shift > 0){
+            left = left << shift | right >> (64 - shift);
+            right <<= shift;
+        }
+        else if(shift <= -64){
+            right = left >> (-shift - 64);
+            left = 0;
+        }
+        else if(shift < 0){
+            right = right >> -shift | left << (64 + shift);
+            left >>= -shift;
+        }
+        rows[i * 2] = left;
+        rows[i * 2 + 1] = right;
+    }
+}
+
+static inline uint64_t diff_wide_scalar(const uint64_t* a, const uint64_t* b, int count){
+    uint64_t mask = 0;
+    for(int i = 0; i < count; i++){
+        if(a[i * 2] != b[i * 2] || a[i * 2 + 1] != b[i * 2 + 1]){
+            mask |= (uint64_t)1 << i;
+        }
+    }
+    return mask;
+}
+
+static const struct screen_kernels scalar_kernels = {
+    "scalar", blit_scalar, shift_scalar, diff_scalar, blit_wide_scalar, shift_wide_scalar, diff_wide_scalar
+};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+// the target attributes let these be built without -msse2 or -mavx2 for the whole file, they are only
+// ever called once screen_kernels() has checked the cpu can run them
+
+// two rows at a time, SSE2 has no 64 bit rotate so it is a shift each way, a shift by 64 gives 0 so no check for shift = 0
+__attribute__((target("sse2")))
+static uint64_t blit_sse2(uint64_t* rows, const unsigned char* sprite, int count, int shift){
+    // setting up the shift counts costs more than it saves on the smallest sprites
+    if(count < 4){
+        return blit_scalar(rows, sprite, count, shift);
+    }
+    __m128i right = _mm_cvtsi32_si128(shift & 63);
+    __m128i left = _mm_cvtsi32_si128(64 - (shift & 63));
+    __m128i collision = _mm_setzero_si128();
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        __m128i bytes = _mm_set_epi64x((int64_t)((uint64_t)sprite[i + 1] << 56), (int64_t)((uint64_t)sprite[i] << 56));
+        __m128i bits = _mm_or_si128(_mm_srl_epi64(bytes, right), _mm_sll_epi64(bytes, left));
+        __m128i screen = _mm_loadu_si128((const __m128i*)&rows[i]);
+        collision = _mm_or_si128(collision, _mm_and_si128(screen, bits));
+        _mm_storeu_si128((__m128i*)&rows[i], _mm_xor_si128(screen, bits));
+    }
+    uint64_t result = (uint64_t)_mm_cvtsi128_si64(collision) | (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(collision, collision));
+    return result | blit_scalar(rows + i, sprite + i, count - i, shift);
+}
+
+__attribute__((target("sse2")))
+static void shift_sse2(uint64_t* rows, int count, int shift){
+    __m128i amount = _mm_cvtsi32_si128(shift >= 0 ? shift : -shift);
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        __m128i row = _mm_loadu_si128((const __m128i*)&rows[i]);
+        row = shift >= 0 ? _mm_sll_epi64(row, amount) : _mm_srl_epi64(row, amount);
+        _mm_storeu_si128((__m128i*)&rows[i], row);
+    }
+    shift_scalar(rows + i, count - i, shift);
+}
+
+// 64 bit compares are SSE4.1, so the 32 bit halves are compared and then both halves of each row have to match
+__attribute__((target("sse2")))
+static uint64_t diff_sse2(const uint64_t* a, const uint64_t* b, int count){
+    uint64_t mask = 0;
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&a[i]), _mm_loadu_si128((const __m128i*)&b[i]));
+        equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        uint64_t same = _mm_movemask_pd(_mm_castsi128_pd(equal));
+        mask |= (same ^ 3) << i;
+    }
+    return i < count ? mask | diff_scalar(a + i, b + i, count - i) << i : mask;
+}
+
+// a 128 pixel row is one register. both words start out as the sprite row, one gets what stays in the word the
+// sprite starts in and the other what carries over, which one is which depends on the half of the row x is in
+__attribute__((target("sse2")))
+static uint64_t blit_wide_sse2(uint64_t* rows, const unsigned char* sprite, int count, int bytes, int shift){
+    __m128i stay = _mm_cvtsi32_si128(shift & 63);
+    __m128i carry = _mm_cvtsi32_si128(64 - (shift & 63));
+    __m128i first = shift < 64 ? _mm_set_epi64x(0, -1) : _mm_set_epi64x(-1, 0);
+    __m128i collision = _mm_setzero_si128();
+    for(int i = 0; i < count; i++){
+        __m128i both = _mm_set1_epi64x((int64_t)sprite_bits(sprite, i, bytes));
+        __m128i bits = _mm_or_si128(_mm_and_si128(_mm_srl_epi64(both, stay), first), _mm_andnot_si128(first, _mm_sll_epi64(both, carry)));
+        __m128i screen = _mm_loadu_si128((const __m128i*)&rows[i * 2]);
+        collision = _mm_or_si128(collision, _mm_and_si128(screen, bits));
+        _mm_storeu_si128((__m128i*)&rows[i * 2], _mm_xor_si128(screen, bits));
+    }
+    return (uint64_t)_mm_cvtsi128_si64(collision) | (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(collision, collision));
+}
+
+// the bits that cross from one word of a row into the other are moved over 8 bytes, which never crosses into the next row
+__attribute__((target("sse2")))
+static void shift_wide_sse2(uint64_t* rows, int count, int shift){
+    int s = (shift >= 0 ? shift : -shift) & 63;
+    bool whole = shift >= 64 || shift <= -64;
+    __m128i amount = _mm_cvtsi32_si128(s);
+    __m128i across = _mm_cvtsi32_si128(64 - s);
+    for(int i = 0; i < count; i++){
+        __m128i row = _mm_loadu_si128((const __m128i*)&rows[i * 2]);
+        if(whole){
+            row = shift > 0 ? _mm_srli_si128(_mm_sll_epi64(row, amount), 8) : _mm_slli_si128(_mm_srl_epi64(row, amount), 8);
+        }
+        else if(shift > 0){
+            row = _mm_or_si128(_mm_sll_epi64(row, amount), _mm_srli_si128(_mm_srl_epi64(row, across), 8));
+        }
+        else{
+            row = _mm_or_si128(_mm_srl_epi64(row, amount), _mm_slli_si128(_mm_sll_epi64(row, across), 8));
+        }
+        _mm_storeu_si128((__m128i*)&rows[i * 2], row);
+    }
+}
+
+// two rows at a time, the differences in both words of a row are ORed into one and then checked like diff_sse2()
+__attribute__((target("sse2")))
+static uint64_t diff_wide_sse2(const uint64_t* a, const uint64_t* b, int count){
+    uint64_t mask = 0;
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        __m128i top = _mm_xor_si128(_mm_loadu_si128((const __m128i*)&a[i * 2]), _mm_loadu_si128((const __m128i*)&b[i * 2]));
+        __m128i bottom = _mm_xor_si128(_mm_loadu_si128((const __m128i*)&a[i * 2 + 2]), _mm_loadu_si128((const __m128i*)&b[i * 2 + 2]));
+        __m128i changed = _mm_or_si128(_mm_unpacklo_epi64(top, bottom), _mm_unpackhi_epi64(top, bottom));
+        __m128i equal = _mm_cmpeq_epi32(changed, _mm_setzero_si128());
+        equal = _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+        uint64_t same = _mm_movemask_pd(_mm_castsi128_pd(equal));
+        mask |= (same ^ 3) << i;
+    }
+    return i < count ? mask | diff_wide_scalar(a + i * 2, b + i * 2, count - i) << i : mask;
+}
+
+// four rows at a time, vpmovzxbq turns 4 sprite bytes into 4 rows in one go
+__attribute__((target("avx2")))
+static uint64_t blit_avx2(uint64_t* rows, const unsigned char* sprite, int count, int shift){
+    if(count < 4){
+        return blit_scalar(rows, sprite, count, shift);
+    }
+    __m128i right = _mm_cvtsi32_si128(shift & 63);
+    __m128i left = _mm_cvtsi32_si128(64 - (shift & 63));
+    __m256i collision = _mm256_setzero_si256();
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        int32_t packed;
+        memcpy(&packed, &sprite[i], sizeof(packed));
+        __m256i bytes = _mm256_slli_epi64(_mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packed)), 56);
+        __m256i bits = _mm256_or_si256(_mm256_srl_epi64(bytes, right), _mm256_sll_epi64(bytes, left));
+        __m256i screen = _mm256_loadu_si256((const __m256i*)&rows[i]);
+        collision = _mm256_or_si256(collision, _mm256_and_si256(screen, bits));
+        _mm256_storeu_si256((__m256i*)&rows[i], _mm256_xor_si256(screen, bits));
+    }
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(collision), _mm256_extracti128_si256(collision, 1));
+    uint64_t result = (uint64_t)_mm_cvtsi128_si64(half) | (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+    // back to 128 bit registers before anything that isn't AVX runs, the SSE2 code in the caller would
+    // otherwise pay for the dirty upper halves on every instruction
+    _mm256_zeroupper();
+    return result | blit_scalar(rows + i, sprite + i, count - i, shift);
+}
+
+__attribute__((target("avx2")))
+static void shift_avx2(uint64_t* rows, int count, int shift){
+    __m128i amount = _mm_cvtsi32_si128(shift >= 0 ? shift : -shift);
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m256i row = _mm256_loadu_si256((const __m256i*)&rows[i]);
+        row = shift >= 0 ? _mm256_sll_epi64(row, amount) : _mm256_srl_epi64(row, amount);
+        _mm256_storeu_si256((__m256i*)&rows[i], row);
+    }
+    _mm256_zeroupper();
+    shift_scalar(rows + i, count - i, shift);
+}
+
+__attribute__((target("avx2")))
+static uint64_t diff_avx2(const uint64_t* a, const uint64_t* b, int count){
+    uint64_t mask = 0;
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)&a[i]), _mm256_loadu_si256((const __m256i*)&b[i]));
+        uint64_t same = _mm256_movemask_pd(_mm256_castsi256_pd(equal));
+        mask |= (same ^ 15) << i;
+    }
+    _mm256_zeroupper();
+    return i < count ? mask | diff_scalar(a + i, b + i, count - i) << i : mask;
+}
+
+// two 128 pixel rows at a time, the same as the SSE2 ones with the 128 bit lanes as rows
+__attribute__((target("avx2")))
+static uint64_t blit_wide_avx2(uint64_t* rows, const unsigned char* sprite, int count, int bytes, int shift){
+    if(count < 4){
+        return blit_wide_sse2(rows, sprite, count, bytes, shift);
+    }
+    __m128i stay = _mm_cvtsi32_si128(shift & 63);
+    __m128i carry = _mm_cvtsi32_si128(64 - (shift & 63));
+    __m256i first = shift < 64 ? _mm256_set_epi64x(0, -1, 0, -1) : _mm256_set_epi64x(-1, 0, -1, 0);
+    __m256i collision = _mm256_setzero_si256();
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        int64_t top = (int64_t)sprite_bits(sprite, i, bytes);
+        int64_t bottom = (int64_t)sprite_bits(sprite, i + 1, bytes);
+        __m256i both = _mm256_set_epi64x(bottom, bottom, top, top);
+        __m256i bits = _mm256_or_si256(_mm256_and_si256(_mm256_srl_epi64(both, stay), first), _mm256_andnot_si256(first, _mm256_sll_epi64(both, carry)));
+        __m256i screen = _mm256_loadu_si256((const __m256i*)&rows[i * 2]);
+        collision = _mm256_or_si256(collision, _mm256_and_si256(screen, bits));
+        _mm256_storeu_si256((__m256i*)&rows[i * 2], _mm256_xor_si256(screen, bits));
+    }
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(collision), _mm256_extracti128_si256(collision, 1));
+    uint64_t result = (uint64_t)_mm_cvtsi128_si64(half) | (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(half, half));
+    _mm256_zeroupper();
+    return result | blit_wide_sse2(rows + i * 2, sprite + i * bytes, count - i, bytes, shift);
+}
+
+// vpsrldq and vpslldq move bytes within each 128 bit lane, so the carry between words stays inside its own row
+__attribute__((target("avx2")))
+static void shift_wide_avx2(uint64_t* rows, int count, int shift){
+    int s = (shift >= 0 ? shift : -shift) & 63;
+    bool whole = shift >= 64 || shift <= -64;
+    __m128i amount = _mm_cvtsi32_si128(s);
+    __m128i across = _mm_cvtsi32_si128(64 - s);
+    int i = 0;
+    for(; i + 2 <= count; i += 2){
+        __m256i row = _mm256_loadu_si256((const __m256i*)&rows[i * 2]);
+        if(whole){
+            row = shift > 0 ? _mm256_srli_si256(_mm256_sll_epi64(row, amount), 8) : _mm256_slli_si256(_mm256_srl_epi64(row, amount), 8);
+        }
+        else if(shift > 0){
+            row = _mm256_or_si256(_mm256_sll_epi64(row, amount), _mm256_srli_si256(_mm256_srl_epi64(row, across), 8));
+        }
+        else{
+            row = _mm256_or_si256(_mm256_srl_epi64(row, amount), _mm256_slli_si256(_mm256_sll_epi64(row, across), 8));
+        }
+        _mm256_storeu_si256((__m256i*)&rows[i * 2], row);
+    }
+    _mm256_zeroupper();
+    shift_wide_sse2(rows + i * 2, count - i, shift);
+}
+
+// four rows at a time, the unpacks leave the rows in the order 0 2 1 3 and vpermq puts them back
+__attribute__((target("avx2")))
+static uint64_t diff_wide_avx2(const uint64_t* a, const uint64_t* b, int count){
+    uint64_t mask = 0;
+    int i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m256i top = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)&a[i * 2]), _mm256_loadu_si256((const __m256i*)&b[i * 2]));
+        __m256i bottom = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)&a[i * 2 + 4]), _mm256_loadu_si256((const __m256i*)&b[i * 2 + 4]));
+        __m256i changed = _mm256_or_si256(_mm256_unpacklo_epi64(top, bottom), _mm256_unpackhi_epi64(top, bottom));
+        changed = _mm256_permute4x64_epi64(changed, _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i equal = _mm256_cmpeq_epi64(changed, _mm256_setzero_si256());
+        uint64_t same = _mm256_movemask_pd(_mm256_castsi256_pd(equal));
+        mask |= (same ^ 15) << i;
+    }
+    _mm256_zeroupper();
+    return i < count ? mask | diff_wide_sse2(a + i * 2, b + i * 2, count - i) << i : mask;
+}
+
+static const struct screen_kernels sse2_kernels = {
+    "sse2", blit_sse2, shift_sse2, diff_sse2, blit_wide_sse2, shift_wide_sse2, diff_wide_sse2
+};
+static const struct screen_kernels avx2_kernels = {
+    "avx2", blit_avx2, shift_avx2, diff_avx2, blit_wide_avx2, shift_wide_avx2, diff_wide_avx2
+};
+
+static const struct screen_kernels* pick_kernels(void){
+    const char* wanted = getenv("CHIP8_SIMD");
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && (!wanted || strcmp(wanted, "avx2") == 0)){
+        return &avx2_kernels;
+    }
+    if(__builtin_cpu_supports("sse2") && (!wanted || strcmp(wanted, "scalar") != 0)){
+        return &sse2_kernels;
+    }
+    return &scalar_kernels;
+}
+
+#else
+
+static const struct screen_kernels* pick_kernels(void){
+    return &scalar_kernels;
+}
+
+#endif
+
+const struct screen_kernels* screen_kernels(void){
+    static const struct screen_kernels* kernels = 0;
+    if(!kernels){
+        kernels = pick_kernels();
+    }
+    return kernels;
+}
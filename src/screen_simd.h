@@ -0,0 +1,27 @@
+#ifndef SCREEN_SIMD_H
+#define SCREEN_SIMD_H
+
+#include <stdint.h>
+
+// the loops over whole rows that struct screen is built on. each one has a plain C version and, on x86, SSE2 and AVX2
+// versions. the fastest set the cpu can run is picked the first time screen_kernels() is called
+struct screen_kernels{
+    const char* name;
+    // XORs count sprite bytes into count rows in a row, each byte rotated right by shift from the left edge
+    // returns the pixels that were set before and got erased, 0 if there was no collision
+    uint64_t (*blit)(uint64_t* rows, const unsigned char* sprite, int count, int shift);
+    // moves every pixel of count rows left (towards x = 0) by shift, a negative shift goes right, pixels moved off the edge are lost
+    void (*shift)(uint64_t* rows, int count, int shift);
+    // one bit per row, set when row i of a and b differ, count is at most 64
+    uint64_t (*diff)(const uint64_t* a, const uint64_t* b, int count);
+    // the same three for 128 pixel rows, each one 2 words next to each other with the left 64 pixels first. the sprite
+    // rows are bytes wide (1 for Dxyn, 2 for Dxy0), shift goes from 0 to 127 for the blit and -127 to 127 for the shift
+    uint64_t (*blit_wide)(uint64_t* rows, const unsigned char* sprite, int count, int bytes, int shift);
+    void (*shift_wide)(uint64_t* rows, int count, int shift);
+    uint64_t (*diff_wide)(const uint64_t* a, const uint64_t* b, int count);
+};
+
+// the kernels in use, setting CHIP8_SIMD to scalar, sse2 or avx2 in the environment picks a set below what the cpu could do
+const struct screen_kernels* screen_kernels(void);
+
+#endif
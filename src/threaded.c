@@ -0,0 +1,351 @@
+#include "threaded.h"
+#include "chip8.h"
+#include "dispatch.h"
+#include <stdbool.h>
+
+#if defined(__GNUC__)
+
+// opcode -> enum opcode_kind, the index into the label table in exec_threaded()
+static unsigned char kind_table[0x10000];
+static bool kind_table_ready = false;
+
+// VF is worked out lazily on this core: 8xy4, 8xy5, 8xy6, 8xy7 and 8xyE only remember which of them ran last
+// and the values of Vx and Vy it saw, and VF gets its value once something looks at it
+enum pending_flags{
+    FLAGS_NONE, FLAGS_ADD, FLAGS_SUB, FLAGS_SHR, FLAGS_SUBN, FLAGS_SHL
+};
+
+// what VF would have been set to, a is Vx and b is Vy from before the instruction
+static inline unsigned char flags_value(enum pending_flags flags, unsigned char a, unsigned char b){
+    switch(flags){
+        case FLAGS_ADD: return a + b > 0xff;
+        case FLAGS_SUB: return a > b;
+        case FLAGS_SHR: return a & 0x01;
+        case FLAGS_SUBN: return b > a;
+        // see op_shl() in dispatch.c
+        default: return 0;
+    }
+}
+
+// true if the opcode reads or writes VF, those have to see the real value so they go through sync_flags first
+static bool touches_vf(unsigned short opcode, enum opcode_kind kind){
+    unsigned char x = (opcode >> 8) & 0x000f;
+    unsigned char y = (opcode >> 4) & 0x000f;
+    switch(kind){
+        case OP_NOP:
+        case OP_CLS:
+        case OP_RET:
+        case OP_JP:
+        case OP_CALL:
+        case OP_LD_I:
+        case OP_JP_V0:
+        case OP_SCD:
+        case OP_SCR:
+        case OP_SCL:
+        case OP_LOW:
+        case OP_HIGH:
+        case OP_AUDIO:
+            return false;
+        // always sets VF
+        case OP_DRW:
+        case OP_DRW_LARGE:
+            return true;
+        case OP_SE_REG:
+        case OP_SNE_REG:
+        case OP_LD_REG:
+        case OP_OR:
+        case OP_AND:
+        case OP_XOR:
+        case OP_ADD_REG:
+        case OP_SUB:
+        case OP_SUBN:
+            return x == 15 || y == 15;
+        // Fx65 with x = F loads VF as well, everything else only uses Vx
+        default:
+            return x == 15;
+    }
+}
+
+static void kind_table_init(void){
+    if(kind_table_ready){
+        return;
+    }
+    for(int opcode = 0; opcode < 0x10000; opcode++){
+        enum opcode_kind kind = opcode_kind(opcode);
+        // the second half of the label table is sync_flags
+        kind_table[opcode] = touches_vf(opcode, kind) ? OP_COUNT + kind : kind;
+    }
+    kind_table_ready = true;
+}
+
+long exec_threaded(struct chip8* chip8, long count){
+    // in the same order as enum opcode_kind, followed by the opcodes that touch VF
+    static void* const labels[OP_COUNT * 2] = {
+        &&op_nop, &&op_cls, &&op_ret, &&op_jp, &&op_call, &&op_se_byte, &&op_sne_byte, &&op_se_reg, &&op_ld_byte, &&op_add_byte,
+        &&op_ld_reg, &&op_or, &&op_and, &&op_xor, &&op_add_reg, &&op_sub, &&op_shr, &&op_subn, &&op_shl, &&op_sne_reg,
+        &&op_ld_i, &&op_jp_v0, &&op_rnd, &&op_drw, &&op_ld_vx_dt, &&op_ld_vx_k, &&op_ld_dt_vx, &&op_ld_st_vx, &&op_add_i, &&op_ld_f,
+        &&op_ld_b, &&op_ld_mem_vx, &&op_ld_vx_mem,
+        &&op_scd, &&op_scr, &&op_scl, &&op_low, &&op_high, &&op_drw_large,
+        &&op_audio, &&op_pitch,
+        [OP_COUNT ... OP_COUNT * 2 - 1] = &&sync_flags
+    };
+    // where sync_flags goes next, the arithmetic that touches VF has to set it straight away
+    static void* const eager_labels[OP_COUNT] = {
+        &&op_nop, &&op_cls, &&op_ret, &&op_jp, &&op_call, &&op_se_byte, &&op_sne_byte, &&op_se_reg, &&op_ld_byte, &&op_add_byte,
+        &&op_ld_reg, &&op_or, &&op_and, &&op_xor, &&eager_add_reg, &&eager_sub, &&eager_shr, &&eager_subn, &&eager_shl, &&op_sne_reg,
+        &&op_ld_i, &&op_jp_v0, &&op_rnd, &&op_drw, &&op_ld_vx_dt, &&op_ld_vx_k, &&op_ld_dt_vx, &&op_ld_st_vx, &&op_add_i, &&op_ld_f,
+        &&op_ld_b, &&op_ld_mem_vx, &&op_ld_vx_mem,
+        &&op_scd, &&op_scr, &&op_scl, &&op_low, &&op_high, &&op_drw_large,
+        &&op_audio, &&op_pitch
+    };
+    kind_table_init();
+    if(keyboard_waiting(&chip8->keyboard)){
+        return 0;
+    }
+    struct registers* reg = &chip8->reg;
+    unsigned char* memory = chip8->mem.memory_array;
+    long done = 0;
+    unsigned short opcode;
+    unsigned short tmp;
+    enum pending_flags flags = FLAGS_NONE;
+    unsigned char flag_a = 0;
+    unsigned char flag_b = 0;
+
+// gives VF its real value, has to happen before anything outside this function can see the registers
+#define SYNC_FLAGS() \
+    do{ \
+        if(flags != FLAGS_NONE){ \
+            reg->V[15] = flags_value(flags, flag_a, flag_b); \
+            flags = FLAGS_NONE; \
+        } \
+    }while(0)
+
+// every handler ends with this: count the instruction, fetch the next opcode, move the program counter past it
+// and jump to its handler, so each handler has its own indirect jump for the branch predictor to learn
+#define DISPATCH() \
+    do{ \
+        if(done == count){ \
+            SYNC_FLAGS(); \
+            return done; \
+        } \
+        done += 1; \
+        opcode = memory[reg->program_counter & 0x0fff] << 8 | memory[(reg->program_counter + 1) & 0x0fff]; \
+        reg->program_counter += 2; \
+        goto *labels[kind_table[opcode]]; \
+    }while(0)
+#define NNN (opcode & 0x0fff)
+#define X ((opcode >> 8) & 0x000f)
+#define Y ((opcode >> 4) & 0x000f)
+#define KK (opcode & 0x00ff)
+#define N (opcode & 0x000f)
+
+    DISPATCH();
+
+sync_flags:
+    SYNC_FLAGS();
+    goto *eager_labels[kind_table[opcode] - OP_COUNT];
+
+    // see the handlers in dispatch.c, these do exactly the same apart from the arithmetic leaving VF for later
+op_nop:
+    DISPATCH();
+op_cls:
+    clear(&chip8->screen);
+    DISPATCH();
+op_ret:
+    reg->program_counter = pop(chip8);
+    DISPATCH();
+op_jp:
+    reg->program_counter = NNN;
+    DISPATCH();
+op_call:
+    push(chip8, reg->program_counter);
+    reg->program_counter = NNN;
+    DISPATCH();
+op_se_byte:
+    if(reg->V[X] == KK){
+        reg->program_counter += 2;
+    }
+    DISPATCH();
+op_sne_byte:
+    if(reg->V[X] != KK){
+        reg->program_counter += 2;
+    }
+    DISPATCH();
+op_se_reg:
+    if(reg->V[X] == reg->V[Y]){
+        reg->program_counter += 2;
+    }
+    DISPATCH();
+op_ld_byte:
+    reg->V[X] = KK;
+    DISPATCH();
+op_add_byte:
+    reg->V[X] += KK;
+    DISPATCH();
+op_ld_reg:
+    reg->V[X] = reg->V[Y];
+    DISPATCH();
+op_or:
+    reg->V[X] |= reg->V[Y];
+    DISPATCH();
+op_and:
+    reg->V[X] &= reg->V[Y];
+    DISPATCH();
+op_xor:
+    reg->V[X] ^= reg->V[Y];
+    DISPATCH();
+op_add_reg:
+    flags = FLAGS_ADD;
+    flag_a = reg->V[X];
+    flag_b = reg->V[Y];
+    reg->V[X] = flag_a + flag_b;
+    DISPATCH();
+op_sub:
+    flags = FLAGS_SUB;
+    flag_a = reg->V[X];
+    flag_b = reg->V[Y];
+    reg->V[X] = flag_a - flag_b;
+    DISPATCH();
+op_shr:
+    flags = FLAGS_SHR;
+    flag_a = reg->V[X];
+    reg->V[X] = flag_a / 2;
+    DISPATCH();
+op_subn:
+    flags = FLAGS_SUBN;
+    flag_a = reg->V[X];
+    flag_b = reg->V[Y];
+    reg->V[X] = flag_b - flag_a;
+    DISPATCH();
+op_shl:
+    flags = FLAGS_SHL;
+    reg->V[X] *= 2;
+    DISPATCH();
+// the same with VF set right away, for when x or y is F. VF is written before Vx so with x = F the result wins
+eager_add_reg:
+    tmp = reg->V[X] + reg->V[Y];
+    reg->V[15] = tmp > 0xff;
+    reg->V[X] = tmp;
+    DISPATCH();
+eager_sub:
+    tmp = (unsigned char)(reg->V[X] - reg->V[Y]);
+    reg->V[15] = reg->V[X] > reg->V[Y];
+    reg->V[X] = tmp;
+    DISPATCH();
+eager_shr:
+    tmp = reg->V[X] / 2;
+    reg->V[15] = reg->V[X] & 0x01;
+    reg->V[X] = tmp;
+    DISPATCH();
+eager_subn:
+    tmp = (unsigned char)(reg->V[Y] - reg->V[X]);
+    reg->V[15] = reg->V[Y] > reg->V[X];
+    reg->V[X] = tmp;
+    DISPATCH();
+eager_shl:
+    tmp = (unsigned char)(reg->V[X] * 2);
+    reg->V[15] = 0;
+    reg->V[X] = tmp;
+    DISPATCH();
+op_sne_reg:
+    if(reg->V[X] != reg->V[Y]){
+        reg->program_counter += 2;
+    }
+    DISPATCH();
+op_ld_i:
+    reg->I = NNN;
+    DISPATCH();
+op_jp_v0:
+    reg->program_counter = NNN + reg->V[0];
+    DISPATCH();
+op_rnd:
+    reg->V[X] = (chip8_random(chip8) % 255) & KK;
+    DISPATCH();
+op_drw:
+    reg->V[15] = draw_sprite(&chip8->screen, reg->V[X], reg->V[Y], (const char*) &memory[reg->I], N);
+    DISPATCH();
+op_ld_vx_dt:
+    reg->V[X] = delay_timer_get(reg);
+    DISPATCH();
+op_ld_vx_k:
+    reg->V[X] = wait_for_key_press(chip8);
+    if(keyboard_waiting(&chip8->keyboard)){
+        SYNC_FLAGS();
+        return done;
+    }
+    DISPATCH();
+op_ld_dt_vx:
+    delay_timer_set(reg, reg->V[X]);
+    DISPATCH();
+op_ld_st_vx:
+    sound_timer_set(reg, reg->V[X]);
+    DISPATCH();
+op_add_i:
+    reg->I += reg->V[X];
+    DISPATCH();
+op_ld_f:
+    reg->I = reg->V[X] * 5;
+    DISPATCH();
+op_ld_b:
+    memory_set(&chip8->mem, reg->I, reg->V[X] / 100);
+    memory_set(&chip8->mem, reg->I+1, reg->V[X] / 10 % 10);
+    memory_set(&chip8->mem, reg->I+2, reg->V[X] % 10);
+    DISPATCH();
+op_ld_mem_vx:
+    for(int i = 0; i <= X; i++){
+        memory_set(&chip8->mem, reg->I+i, reg->V[X]);
+    }
+    DISPATCH();
+op_ld_vx_mem:
+    for(int i = 0; i <= X; i++){
+        reg->V[i] = memory_get(&chip8->mem, reg->I+i);
+    }
+    DISPATCH();
+op_scd:
+    scroll_down(&chip8->screen, N);
+    DISPATCH();
+op_scr:
+    scroll_right(&chip8->screen, 4);
+    DISPATCH();
+op_scl:
+    scroll_left(&chip8->screen, 4);
+    DISPATCH();
+op_low:
+    screen_set_hires(&chip8->screen, false);
+    DISPATCH();
+op_high:
+    screen_set_hires(&chip8->screen, true);
+    DISPATCH();
+op_drw_large:
+    reg->V[15] = draw_large_sprite(&chip8->screen, reg->V[X], reg->V[Y], (const char*) &memory[reg->I]);
+    DISPATCH();
+op_audio:
+    for(int i = 0; i < 16; i++){
+        reg->pattern[i] = memory_get(&chip8->mem, reg->I+i);
+    }
+    reg->pattern_version += 1;
+    DISPATCH();
+op_pitch:
+    reg->pitch = reg->V[X];
+    DISPATCH();
+
+#undef DISPATCH
+#undef SYNC_FLAGS
+#undef NNN
+#undef X
+#undef Y
+#undef KK
+#undef N
+}
+
+#else
+
+long exec_threaded(struct chip8* chip8, long count){
+    long i = 0;
+    for(; i < count && !keyboard_waiting(&chip8->keyboard); i++){
+        step(chip8);
+    }
+    return i;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef THREADED_H
+#define THREADED_H
+
+struct chip8;
+
+// runs count instructions on the threaded core, returns how many were run
+// with GCC or Clang every handler jumps straight to the next one through a label address (labels as values),
+// other compilers get a plain loop over step()
+// VF is only worked out when an instruction needs it, it always holds the right value again by the time this returns
+long exec_threaded(struct chip8* chip8, long count);
+
+#endif